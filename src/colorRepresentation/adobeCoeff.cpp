@@ -5,5 +5,5 @@
 #include "adobeCoeff.h"
 #include "../common/globals.h"
 
-unsigned ADOBE_black;
-unsigned ADOBE_maximum;
+thread_local unsigned ADOBE_black;
+thread_local unsigned ADOBE_maximum;
@@ -1,7 +1,7 @@
 #ifndef __ADOBE_COEFF__
 #define __ADOBE_COEFF__
 
-extern unsigned ADOBE_black;
-extern unsigned ADOBE_maximum;
+extern thread_local unsigned ADOBE_black;
+extern thread_local unsigned ADOBE_maximum;
 
 #endif
@@ -1,5 +1,208 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CIELAB_X86
+#include <immintrin.h>
+#endif
+
+#include <math.h>
+
 #include "../common/util.h"
 #include "../common/mathMacros.h"
+#include "../common/cpuFeatures.h"
 #include "../imageHandling/BayessianImage.h"
 #include "cielab.h"
 
+// Converts a prefix of the row, returns the number of pixels converted
+typedef int (*CielabRowKernel)(const unsigned short (*rgb)[3], short *l, short *a, short *b, int count, const float (*xyzCam)[4], const float *cbrt);
+
+static bool
+fillCubeRoots(float *cbrt) {
+    int i;
+    float r;
+
+    for ( i = 0; i < 0x10000; i++ ) {
+        r = i / 65535.0;
+        cbrt[i] = r > 0.008856 ? pow(r, 1 / 3.0) : 7.787 * r + 16 / 116.0;
+    }
+    return true;
+}
+
+const float *
+cielabCubeRoots() {
+    static float cbrt[0x10000];
+    static const bool ready = fillCubeRoots(cbrt);
+
+    (void)ready;
+    return cbrt;
+}
+
+/*
+Pixels first to count - 1, one at a time, with the same float operations as cielab()
+*/
+static void
+cielabScalar(const unsigned short (*rgb)[3], short *l, short *a, short *b, int first, int count, const float (*xyzCam)[4], const float *cbrt) {
+    float xyz[3];
+    int i;
+    int c;
+
+    for ( i = first; i < count; i++ ) {
+        xyz[0] = xyz[1] = xyz[2] = 0.5;
+        for ( c = 0; c < 3; c++ ) {
+            xyz[0] += xyzCam[0][c] * rgb[i][c];
+            xyz[1] += xyzCam[1][c] * rgb[i][c];
+            xyz[2] += xyzCam[2][c] * rgb[i][c];
+        }
+        xyz[0] = cbrt[CLIP((int) xyz[0])];
+        xyz[1] = cbrt[CLIP((int) xyz[1])];
+        xyz[2] = cbrt[CLIP((int) xyz[2])];
+        l[i] = 64 * (116 * xyz[1] - 16);
+        a[i] = 64 * 500 * (xyz[0] - xyz[1]);
+        b[i] = 64 * 200 * (xyz[1] - xyz[2]);
+    }
+}
+
+#ifdef CIELAB_X86
+
+/*
+Clamping to [0, 65535] before truncating gives the same index as CLIP((int) x)
+*/
+__attribute__((target("sse2")))
+static inline __m128i
+cubeRootIndexSse2(__m128 x) {
+    return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(65535)));
+}
+
+/*
+Four pixels at a time, the table lookups one by one
+*/
+__attribute__((target("sse2")))
+static int
+cielabSse2(const unsigned short (*rgb)[3], short *l, short *a, short *b, int count, const float (*xyzCam)[4], const float *cbrt) {
+    int index[3][4];
+    __m128 m[3][3];
+    __m128 in[3];
+    __m128 xyz[3];
+    int i;
+    int j;
+    int c;
+
+    for ( j = 0; j < 3; j++ ) {
+        for ( c = 0; c < 3; c++ ) {
+            m[j][c] = _mm_set1_ps(xyzCam[j][c]);
+        }
+    }
+    for ( i = 0; i + 4 <= count; i += 4 ) {
+        for ( c = 0; c < 3; c++ ) {
+            in[c] = _mm_cvtepi32_ps(_mm_setr_epi32(rgb[i][c], rgb[i + 1][c], rgb[i + 2][c], rgb[i + 3][c]));
+        }
+        for ( j = 0; j < 3; j++ ) {
+            xyz[j] = _mm_add_ps(_mm_set1_ps(0.5), _mm_mul_ps(m[j][0], in[0]));
+            xyz[j] = _mm_add_ps(xyz[j], _mm_mul_ps(m[j][1], in[1]));
+            xyz[j] = _mm_add_ps(xyz[j], _mm_mul_ps(m[j][2], in[2]));
+            _mm_storeu_si128((__m128i *) index[j], cubeRootIndexSse2(xyz[j]));
+            xyz[j] = _mm_setr_ps(cbrt[index[j][0]], cbrt[index[j][1]], cbrt[index[j][2]], cbrt[index[j][3]]);
+        }
+        _mm_storel_epi64((__m128i *) (l + i), _mm_packs_epi32(_mm_cvttps_epi32(
+            _mm_mul_ps(_mm_set1_ps(64), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(116), xyz[1]), _mm_set1_ps(16)))), _mm_setzero_si128()));
+        _mm_storel_epi64((__m128i *) (a + i), _mm_packs_epi32(_mm_cvttps_epi32(
+            _mm_mul_ps(_mm_set1_ps(64 * 500), _mm_sub_ps(xyz[0], xyz[1]))), _mm_setzero_si128()));
+        _mm_storel_epi64((__m128i *) (b + i), _mm_packs_epi32(_mm_cvttps_epi32(
+            _mm_mul_ps(_mm_set1_ps(64 * 200), _mm_sub_ps(xyz[1], xyz[2]))), _mm_setzero_si128()));
+    }
+    return i;
+}
+
+/*
+Packs the eight 32-bit values of x, all in the short range, into eight shorts at destination
+*/
+__attribute__((target("avx2")))
+static inline void
+storeShortsAvx2(short *destination, __m256i x) {
+    _mm_storeu_si128((__m128i *) destination,
+                     _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+}
+
+/*
+Eight pixels at a time: the 24 samples are split into color planes with byte shuffles and the table is
+read with gathers
+*/
+__attribute__((target("avx2")))
+static int
+cielabAvx2(const unsigned short (*rgb)[3], short *l, short *a, short *b, int count, const float (*xyzCam)[4], const float *cbrt) {
+    unsigned char shuffle[3][3][16];
+    __m128i split[3][3];
+    __m128i samples[3];
+    __m256 m[3][3];
+    __m256 in[3];
+    __m256 xyz[3];
+    __m256i index;
+    int sample;
+    int i;
+    int j;
+    int c;
+
+    // shuffle[c][j] takes the samples of color c found in the j-th 8 samples
+    for ( c = 0; c < 3; c++ ) {
+        for ( j = 0; j < 3; j++ ) {
+            for ( i = 0; i < 8; i++ ) {
+                sample = 3 * i + c - 8 * j;
+                shuffle[c][j][2 * i] = sample >= 0 && sample < 8 ? 2 * sample : 0x80;
+                shuffle[c][j][2 * i + 1] = sample >= 0 && sample < 8 ? 2 * sample + 1 : 0x80;
+            }
+            split[c][j] = _mm_loadu_si128((const __m128i *) shuffle[c][j]);
+        }
+    }
+    for ( j = 0; j < 3; j++ ) {
+        for ( c = 0; c < 3; c++ ) {
+            m[j][c] = _mm256_set1_ps(xyzCam[j][c]);
+        }
+    }
+    for ( i = 0; i + 8 <= count; i += 8 ) {
+        for ( j = 0; j < 3; j++ ) {
+            samples[j] = _mm_loadu_si128((const __m128i *) (rgb[i] + 8 * j));
+        }
+        for ( c = 0; c < 3; c++ ) {
+            in[c] = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_or_si128(
+                _mm_or_si128(_mm_shuffle_epi8(samples[0], split[c][0]), _mm_shuffle_epi8(samples[1], split[c][1])),
+                _mm_shuffle_epi8(samples[2], split[c][2]))));
+        }
+        for ( j = 0; j < 3; j++ ) {
+            xyz[j] = _mm256_add_ps(_mm256_set1_ps(0.5), _mm256_mul_ps(m[j][0], in[0]));
+            xyz[j] = _mm256_add_ps(xyz[j], _mm256_mul_ps(m[j][1], in[1]));
+            xyz[j] = _mm256_add_ps(xyz[j], _mm256_mul_ps(m[j][2], in[2]));
+            index = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(xyz[j], _mm256_setzero_ps()), _mm256_set1_ps(65535)));
+            xyz[j] = _mm256_i32gather_ps(cbrt, index, 4);
+        }
+        storeShortsAvx2(l + i, _mm256_cvttps_epi32(
+            _mm256_mul_ps(_mm256_set1_ps(64), _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(116), xyz[1]), _mm256_set1_ps(16)))));
+        storeShortsAvx2(a + i, _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_set1_ps(64 * 500), _mm256_sub_ps(xyz[0], xyz[1]))));
+        storeShortsAvx2(b + i, _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_set1_ps(64 * 200), _mm256_sub_ps(xyz[1], xyz[2]))));
+    }
+    return i;
+}
+
+#endif
+
+static CielabRowKernel
+selectKernel() {
+#ifdef CIELAB_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        return cielabAvx2;
+    }
+    if ( cpuFeatures() & CPU_SSE2 ) {
+        return cielabSse2;
+    }
+#endif
+    return nullptr;
+}
+
+void
+cielabRow(const unsigned short (*rgb)[3], short *l, short *a, short *b, int count, const float (*xyzCam)[4]) {
+    static const CielabRowKernel kernel = selectKernel();
+    const float *cbrt = cielabCubeRoots();
+    int done = 0;
+
+    if ( kernel ) {
+        done = kernel(rgb, l, a, b, count, xyzCam, cbrt);
+    }
+    cielabScalar(rgb, l, a, b, done, count, xyzCam, cbrt);
+}
@@ -1,5 +1,18 @@
 #ifndef __CIELAB__
 #define __CIELAB__
 
+/**
+ * The cube root table of cielab(): f(t) for t = i / 65535, f being t ^ (1 / 3) with its linear part
+ * near 0. It does not depend on the camera, so it is filled on the first call and shared by all threads.
+ */
+extern const float *cielabCubeRoots();
+
+/**
+ * Converts count camera RGB pixels to CIELab exactly as cielab() does for three colors, xyzCam being the
+ * camera to XYZ matrix it sets up. The Lab values go to three separate planes.
+ *
+ * Eight or four pixels are converted at a time with AVX2 or SSE2 when the processor has them.
+ */
+extern void cielabRow(const unsigned short (*rgb)[3], short *l, short *a, short *b, int count, const float (*xyzCam)[4]);
 
 #endif
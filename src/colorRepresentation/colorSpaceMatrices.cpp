@@ -1,3 +1,224 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define COLOR_MATRIX_X86
+#include <immintrin.h>
+#endif
+
 #include "cielab.h"
+#include "../common/mathMacros.h"
+#include "../common/cpuFeatures.h"
 #include "colorSpaceMatrices.h"
 
+
+// Converts a prefix of the row, returns the number of pixels converted
+typedef int (*ColorMatrixKernel)(unsigned short *samples[4], int count, int colors, const float matrix[3][4]);
+
+struct ColorMatrixKernels {
+    ColorMatrixKernel interleaved;
+    ColorMatrixKernel planar;
+};
+
+static void
+colorMatrixScalar(unsigned short *samples[4], int step, int first, int count, int colors, const float matrix[3][4]) {
+    float out[3];
+    int i;
+    int c;
+
+    for ( i = first * step; i < count * step; i += step ) {
+        out[0] = out[1] = out[2] = 0;
+        for ( c = 0; c < colors; c++ ) {
+            out[0] += matrix[0][c] * samples[c][i];
+            out[1] += matrix[1][c] * samples[c][i];
+            out[2] += matrix[2][c] * samples[c][i];
+        }
+        for ( c = 0; c < 3; c++ ) {
+            samples[c][i] = CLIP((int) out[c]);
+        }
+    }
+}
+
+#ifdef COLOR_MATRIX_X86
+
+/*
+Converts the pixel in the four lanes of in, each lane summing one output color from the matrix columns.
+The lane of channel 3 gets its input back.
+*/
+__attribute__((target("sse4.1")))
+static inline __m128i
+interleavedPixelSse41(__m128i in, const __m128 column[4], int colors) {
+    __m128 value = _mm_cvtepi32_ps(in);
+    __m128 sum;
+
+    sum = _mm_mul_ps(column[0], _mm_shuffle_ps(value, value, 0x00));
+    sum = _mm_add_ps(sum, _mm_mul_ps(column[1], _mm_shuffle_ps(value, value, 0x55)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(column[2], _mm_shuffle_ps(value, value, 0xaa)));
+    if ( colors == 4 ) {
+        sum = _mm_add_ps(sum, _mm_mul_ps(column[3], _mm_shuffle_ps(value, value, 0xff)));
+    }
+    return _mm_blend_epi16(_mm_cvttps_epi32(sum), in, 0xc0);
+}
+
+__attribute__((target("sse4.1")))
+static int
+interleavedSse41(unsigned short *samples[4], int count, int colors, const float matrix[3][4]) {
+    unsigned short *pix = samples[0];
+    __m128 column[4];
+    __m128i in;
+    int i;
+    int c;
+
+    for ( c = 0; c < 4; c++ ) {
+        column[c] = c < colors ? _mm_setr_ps(matrix[0][c], matrix[1][c], matrix[2][c], 0) : _mm_setzero_ps();
+    }
+    for ( i = 0; i + 2 <= count; i += 2 ) {
+        in = _mm_loadu_si128((const __m128i *) (pix + i * 4));
+        _mm_storeu_si128((__m128i *) (pix + i * 4),
+                         _mm_packus_epi32(interleavedPixelSse41(_mm_cvtepu16_epi32(in), column, colors),
+                                          interleavedPixelSse41(_mm_cvtepu16_epi32(_mm_srli_si128(in, 8)), column, colors)));
+    }
+    return i;
+}
+
+/*
+Four pixels per register, one register per channel
+*/
+__attribute__((target("sse4.1")))
+static int
+planarSse41(unsigned short *samples[4], int count, int colors, const float matrix[3][4]) {
+    __m128 in[4];
+    __m128 sum;
+    __m128i out[3];
+    int i;
+    int k;
+    int c;
+
+    for ( i = 0; i + 4 <= count; i += 4 ) {
+        for ( c = 0; c < colors; c++ ) {
+            in[c] = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) (samples[c] + i))));
+        }
+        for ( k = 0; k < 3; k++ ) {
+            sum = _mm_mul_ps(_mm_set1_ps(matrix[k][0]), in[0]);
+            for ( c = 1; c < colors; c++ ) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(matrix[k][c]), in[c]));
+            }
+            out[k] = _mm_cvttps_epi32(sum);
+        }
+        for ( k = 0; k < 3; k++ ) {
+            _mm_storel_epi64((__m128i *) (samples[k] + i), _mm_packus_epi32(out[k], out[k]));
+        }
+    }
+    return i;
+}
+
+/*
+Two pixels per register, one in each 128-bit lane
+*/
+__attribute__((target("avx2")))
+static inline __m256i
+interleavedPixelsAvx2(__m256i in, const __m256 column[4], int colors) {
+    __m256 value = _mm256_cvtepi32_ps(in);
+    __m256 sum;
+
+    sum = _mm256_mul_ps(column[0], _mm256_shuffle_ps(value, value, 0x00));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(column[1], _mm256_shuffle_ps(value, value, 0x55)));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(column[2], _mm256_shuffle_ps(value, value, 0xaa)));
+    if ( colors == 4 ) {
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(column[3], _mm256_shuffle_ps(value, value, 0xff)));
+    }
+    return _mm256_blend_epi32(_mm256_cvttps_epi32(sum), in, 0x88);
+}
+
+__attribute__((target("avx2")))
+static int
+interleavedAvx2(unsigned short *samples[4], int count, int colors, const float matrix[3][4]) {
+    unsigned short *pix = samples[0];
+    __m256 column[4];
+    __m256i low;
+    __m256i high;
+    int i;
+    int c;
+
+    for ( c = 0; c < 4; c++ ) {
+        column[c] = c < colors ? _mm256_setr_ps(matrix[0][c], matrix[1][c], matrix[2][c], 0,
+                                                matrix[0][c], matrix[1][c], matrix[2][c], 0) : _mm256_setzero_ps();
+    }
+    for ( i = 0; i + 4 <= count; i += 4 ) {
+        low = interleavedPixelsAvx2(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (pix + i * 4))),
+                                    column, colors);
+        high = interleavedPixelsAvx2(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (pix + i * 4 + 8))),
+                                     column, colors);
+        _mm256_storeu_si256((__m256i *) (pix + i * 4),
+                            _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xd8));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int
+planarAvx2(unsigned short *samples[4], int count, int colors, const float matrix[3][4]) {
+    __m256 in[4];
+    __m256 sum;
+    __m256i out[3];
+    int i;
+    int k;
+    int c;
+
+    for ( i = 0; i + 8 <= count; i += 8 ) {
+        for ( c = 0; c < colors; c++ ) {
+            in[c] = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (samples[c] + i))));
+        }
+        for ( k = 0; k < 3; k++ ) {
+            sum = _mm256_mul_ps(_mm256_set1_ps(matrix[k][0]), in[0]);
+            for ( c = 1; c < colors; c++ ) {
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(matrix[k][c]), in[c]));
+            }
+            out[k] = _mm256_cvttps_epi32(sum);
+        }
+        for ( k = 0; k < 3; k++ ) {
+            _mm_storeu_si128((__m128i *) (samples[k] + i),
+                             _mm_packus_epi32(_mm256_castsi256_si128(out[k]), _mm256_extracti128_si256(out[k], 1)));
+        }
+    }
+    return i;
+}
+
+#endif
+
+static struct ColorMatrixKernels
+selectKernels() {
+    struct ColorMatrixKernels kernels = {nullptr, nullptr};
+
+#ifdef COLOR_MATRIX_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        kernels.interleaved = interleavedAvx2;
+        kernels.planar = planarAvx2;
+    } else {
+        if ( cpuFeatures() & CPU_SSE41 ) {
+            kernels.interleaved = interleavedSse41;
+            kernels.planar = planarSse41;
+        }
+    }
+#endif
+    return kernels;
+}
+
+static const struct ColorMatrixKernels &
+kernels() {
+    static const struct ColorMatrixKernels selected = selectKernels();
+
+    return selected;
+}
+
+void
+colorMatrixRow(unsigned short *samples[4], int step, int count, int colors, const float matrix[3][4]) {
+    int done = 0;
+
+    if ( colors == 3 || colors == 4 ) {
+        if ( step == 4 && kernels().interleaved && samples[1] == samples[0] + 1 && samples[2] == samples[0] + 2 ) {
+            done = kernels().interleaved(samples, count, colors, matrix);
+        }
+        if ( step == 1 && kernels().planar ) {
+            done = kernels().planar(samples, count, colors, matrix);
+        }
+    }
+    colorMatrixScalar(samples, step, done, count, colors, matrix);
+}
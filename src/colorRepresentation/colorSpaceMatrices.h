@@ -1,5 +1,14 @@
 #ifndef __COLORSPACEMATRICES__
 #define __COLORSPACEMATRICES__
 
+/**
+ * Converts count pixels of a row in place, as convert_to_rgb() does: output color k, for k < 3, is the sum of
+ * matrix[k][c] * sample c over the colors, added in that order in float, then truncated and clipped to
+ * 0..65535. samples are the rows of the channels, their samples step apart; channel 3 is left as it is.
+ *
+ * Interleaved (step 4) and planar (step 1) rows of 3 or 4 colors are converted with SSE4.1 or AVX2 when the
+ * processor has them, with the same float operations, so results do not depend on the instruction set.
+ */
+extern void colorMatrixRow(unsigned short *samples[4], int step, int count, int colors, const float matrix[3][4]);
 
 #endif
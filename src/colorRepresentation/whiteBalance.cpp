@@ -1,3 +1,8 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WHITE_BALANCE_X86
+#include <immintrin.h>
+#endif
+
 // C
 #include <cstdio>
 #include <cstring>
@@ -5,9 +10,94 @@
 // App modules
 #include "../common/Options.h"
 #include "../common/mathMacros.h"
+#include "../common/cpuFeatures.h"
 #include "../imageHandling/BayessianImage.h"
 #include "../common/CameraImageInformation.h"
 #include "adobeCoeff.h"
 #include "cielab.h"
 #include "whiteBalance.h"
 
+
+// Scales a prefix of the samples, returns the number of samples scaled
+typedef int (*WhiteBalanceKernel)(unsigned short *samples, int count, const int *black, const float *scale);
+
+static void
+whiteBalanceScalar(unsigned short *samples, int first, int count, const int *black, const float *scale) {
+    int val;
+    int i;
+
+    for ( i = first; i < count; i++ ) {
+        if ( !(val = samples[i]) ) {
+            continue;
+        }
+        val -= black[i];
+        val *= scale[i];
+        samples[i] = CLIP(val);
+    }
+}
+
+#ifdef WHITE_BALANCE_X86
+
+/*
+The float to int conversion truncates, as the scalar one does, and saturating packs do the clipping
+*/
+__attribute__((target("sse4.1")))
+static int
+whiteBalanceSse41(unsigned short *samples, int count, const int *black, const float *scale) {
+    __m128i in;
+    __m128i val;
+    int i;
+
+    for ( i = 0; i + 4 <= count; i += 4 ) {
+        in = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) (samples + i)));
+        val = _mm_sub_epi32(in, _mm_loadu_si128((const __m128i *) (black + i)));
+        val = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(val), _mm_loadu_ps(scale + i)));
+        val = _mm_andnot_si128(_mm_cmpeq_epi32(in, _mm_setzero_si128()), val);
+        _mm_storel_epi64((__m128i *) (samples + i), _mm_packus_epi32(val, val));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int
+whiteBalanceAvx2(unsigned short *samples, int count, const int *black, const float *scale) {
+    __m256i in;
+    __m256i val;
+    int i;
+
+    for ( i = 0; i + 8 <= count; i += 8 ) {
+        in = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (samples + i)));
+        val = _mm256_sub_epi32(in, _mm256_loadu_si256((const __m256i *) (black + i)));
+        val = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(val), _mm256_loadu_ps(scale + i)));
+        val = _mm256_andnot_si256(_mm256_cmpeq_epi32(in, _mm256_setzero_si256()), val);
+        _mm_storeu_si128((__m128i *) (samples + i),
+                         _mm_packus_epi32(_mm256_castsi256_si128(val), _mm256_extracti128_si256(val, 1)));
+    }
+    return i;
+}
+
+#endif
+
+static WhiteBalanceKernel
+selectKernel() {
+#ifdef WHITE_BALANCE_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        return whiteBalanceAvx2;
+    }
+    if ( cpuFeatures() & CPU_SSE41 ) {
+        return whiteBalanceSse41;
+    }
+#endif
+    return nullptr;
+}
+
+void
+whiteBalanceRow(unsigned short *samples, int count, const int *black, const float *scale) {
+    static const WhiteBalanceKernel kernel = selectKernel();
+    int done = 0;
+
+    if ( kernel ) {
+        done = kernel(samples, count, black, scale);
+    }
+    whiteBalanceScalar(samples, done, count, black, scale);
+}
@@ -1,4 +1,13 @@
 #ifndef __WHITEBALANCE__
 #define __WHITEBALANCE__
 
+/**
+ * Scales count samples in place as scale_colors() does: each non zero sample becomes
+ * CLIP((int) ((sample - black[i]) * scale[i])), zeros stay zero. black and scale hold one value per sample,
+ * so they carry the black pattern and the channel of each one.
+ *
+ * Samples are done eight at a time with AVX2 or four at a time with SSE4.1 when the processor has them.
+ */
+extern void whiteBalanceRow(unsigned short *samples, int count, const int *black, const float *scale);
+
 #endif
@@ -3,14 +3,7 @@
 #include <cstring>
 #include "CameraImageInformation.h"
 
-CameraImageInformation CAMERA_IMAGE_information;
-
-CameraImageInformation::CameraImageInformation() {
-    resetValues();
-}
-
-CameraImageInformation::~CameraImageInformation() {
-}
+thread_local CameraImageInformation CAMERA_IMAGE_information;
 
 void
 CameraImageInformation::resetValues() {
@@ -9,11 +9,11 @@ class CameraImageInformation {
     // Image
     char *inputFilename;
 
-    CameraImageInformation();
-    ~CameraImageInformation();
+    // Constant initialization keeps the thread_local CAMERA_IMAGE_information free of dynamic initialization
+    constexpr CameraImageInformation(): shutterSpeed(0), inputFilename(0) {}
     void resetValues();
 };
 
-extern CameraImageInformation CAMERA_IMAGE_information;
+extern thread_local CameraImageInformation CAMERA_IMAGE_information;
 
 #endif
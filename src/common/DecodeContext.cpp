@@ -0,0 +1,98 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "globals.h"
+#include "CameraImageInformation.h"
+#include "../imageHandling/BayessianImage.h"
+#include "../persistence/readers/globalsio.h"
+#include "DecodeContext.h"
+
+DecodeContext::DecodeContext(Options *options) {
+    previousOptions = OPTIONS_values;
+    OPTIONS_values = options;
+    THE_image.rawData = nullptr;
+    GLOBAL_image = nullptr;
+    memset(&GLOBAL_planarImage, 0, sizeof GLOBAL_planarImage);
+    GLOBAL_outputIccProfile = nullptr;
+    meta_data = nullptr;
+    GLOBAL_IO_ifp = nullptr;
+    ofp = stdout;
+}
+
+DecodeContext::~DecodeContext() {
+    inputRelease();
+    if ( GLOBAL_IO_ifp ) {
+        fclose(GLOBAL_IO_ifp);
+        GLOBAL_IO_ifp = nullptr;
+    }
+    if ( ofp && ofp != stdout ) {
+        fclose(ofp);
+    }
+    ofp = stdout;
+    if ( meta_data ) {
+        free(meta_data);
+        meta_data = nullptr;
+    }
+    if ( GLOBAL_outputIccProfile ) {
+        free(GLOBAL_outputIccProfile);
+        GLOBAL_outputIccProfile = nullptr;
+    }
+    if ( GLOBAL_image ) {
+        free(GLOBAL_image);
+        GLOBAL_image = nullptr;
+    }
+    imageBufferRelease(&GLOBAL_planarImage);
+    if ( THE_image.rawData ) {
+        free(THE_image.rawData);
+        THE_image.rawData = nullptr;
+    }
+    if ( CAMERA_IMAGE_information.inputFilename ) {
+        delete[] CAMERA_IMAGE_information.inputFilename;
+        CAMERA_IMAGE_information.inputFilename = nullptr;
+    }
+    OPTIONS_values = previousOptions;
+}
+
+/*
+Opens the raw file to decode as GLOBAL_IO_ifp, memory mapped when possible. The file is closed when the
+context is destroyed.
+*/
+FILE *
+DecodeContext::openInput(const char *filename) {
+    if ( CAMERA_IMAGE_information.inputFilename ) {
+        delete[] CAMERA_IMAGE_information.inputFilename;
+    }
+    CAMERA_IMAGE_information.inputFilename = new char[strlen(filename) + 1];
+    strcpy(CAMERA_IMAGE_information.inputFilename, filename);
+    GLOBAL_IO_ifp = fopen(CAMERA_IMAGE_information.inputFilename, "rb");
+    inputMap(GLOBAL_IO_ifp);
+    return GLOBAL_IO_ifp;
+}
+
+/*
+Opens a raw file already loaded in memory as GLOBAL_IO_ifp. The buffer is read in place, so it has to
+outlive the context. Messages refer to the file as "memory buffer".
+*/
+FILE *
+DecodeContext::openInput(const void *buffer, size_t length) {
+    static const char name[] = "memory buffer";
+
+    if ( CAMERA_IMAGE_information.inputFilename ) {
+        delete[] CAMERA_IMAGE_information.inputFilename;
+    }
+    CAMERA_IMAGE_information.inputFilename = new char[sizeof name];
+    strcpy(CAMERA_IMAGE_information.inputFilename, name);
+#if defined(WIN32) || defined(DJGPP)
+    GLOBAL_IO_ifp = tmpfile();
+    if ( GLOBAL_IO_ifp ) {
+        fwrite(buffer, 1, length, GLOBAL_IO_ifp);
+        fseek(GLOBAL_IO_ifp, 0, SEEK_SET);
+    }
+#else
+    GLOBAL_IO_ifp = fmemopen((void *) buffer, length, "rb");
+#endif
+    if ( GLOBAL_IO_ifp ) {
+        inputAttach(GLOBAL_IO_ifp, buffer, length);
+    }
+    return GLOBAL_IO_ifp;
+}
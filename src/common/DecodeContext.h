@@ -0,0 +1,31 @@
+#ifndef __DECODE_CONTEXT__
+#define __DECODE_CONTEXT__
+
+#include <cstdio>
+
+#include "Options.h"
+
+/**
+ * A DecodeContext owns the decoding of one raw file on the calling thread.
+ *
+ * The decoding state (GLOBAL_image, THE_image, GLOBAL_IO_ifp, IMAGE_filters, cblack, pre_mul, OPTIONS_values,
+ * the bit reader buffers...) is thread_local, so each thread has its own copy of it. A DecodeContext binds the
+ * options to use to the current thread, owns the input and output files and releases every buffer allocated
+ * by the pipeline when it goes out of scope, even after a longjmp to `failure`. N threads holding one
+ * DecodeContext each can decode N different files with no shared mutable state.
+ *
+ * Helper threads started from inside a decoding step do not see the state of the thread that started them:
+ * whatever they need has to be handed to them explicitly.
+ */
+class DecodeContext {
+  private:
+    Options *previousOptions;
+
+  public:
+    explicit DecodeContext(Options *options);
+    ~DecodeContext();
+    FILE *openInput(const char *filename);
+    FILE *openInput(const void *buffer, size_t length);
+};
+
+#endif
@@ -12,7 +12,7 @@
     #define nullptr 0
 #endif
 
-Options *OPTIONS_values;
+thread_local Options *OPTIONS_values;
 
 Options::Options() { // NOLINT(cppcoreguidelines-pro-type-member-init)
     user_flip = -1;
@@ -48,6 +48,11 @@ Options::Options() { // NOLINT(cppcoreguidelines-pro-type-member-init)
     outputTiff = 0;
     med_passes = 0;
     noAutoBright = 0;
+    threads = 0;
+    tileMemory = 0;
+    planarImage = 0;
+    denoiseMemory = 0;
+    fusedOutput = 0;
 
     chromaticAberrationCorrection[0] = 1;
     chromaticAberrationCorrection[1] = 1;
@@ -97,6 +102,7 @@ Options::printHelp(const char **argv) {
     puts("-k <num>  Set the darkness level");
     puts("-S <num>  Set the saturation level");
     puts("-n <num>  Set threshold for wavelet denoising");
+    puts("-N <num>  Denoise in tiles that fit num MB");
     puts("-H [0-9]  Highlight mode (0=clip, 1=unclip, 2=blend, 3+=rebuild)");
     puts("-t [0-7]  Flip GLOBAL_image (0=none, 3=180, 5=90CCW, 6=90CW)");
     puts("-o [0-6]  Output colorspace (raw,sRGB,Adobe,Wide,ProPhoto,XYZ,ACES)");
@@ -118,6 +124,10 @@ Options::printHelp(const char **argv) {
     puts("-6        Write 16-bit instead of 8-bit");
     puts("-4        Linear 16-bit, same as \"-6 -W -g 1 1\"");
     puts("-T        Write TIFF instead of PPM");
+    puts("-J <num>  Use num threads (default = one per CPU)");
+    puts("-L <num>  Size X-Trans tiles to fit num KB of cache for all threads");
+    puts("-Y        Keep the image planar for the last stages");
+    puts("-F        Convert colors while writing the image");
     puts("");
 }
 
@@ -137,8 +147,8 @@ Options::setArguments(int argc, const char **argv) {
 
     for ( arg = 1; (((opm = argv[arg][0]) - 2) | 2) == '+'; ) {
         opt = argv[arg++][1];
-        if ( (cp = (char *) strchr (sp="nbrkStqmHACg", opt)) ) {
-            for ( int i = 0; i < "114111111422"[cp - sp] - '0'; i++ ) {
+        if ( (cp = (char *) strchr (sp="nbrkStqmHACgJLN", opt)) ) {
+            for ( int i = 0; i < "114111111422111"[cp - sp] - '0'; i++ ) {
                 if ( !isdigit(argv[arg + i][0])) {
                     fprintf(stderr, "Non-numeric argument to \"-%c\"\n", opt);
                     return 1;
@@ -150,6 +160,9 @@ Options::setArguments(int argc, const char **argv) {
             case 'n':
                 threshold = atof(argv[arg++]);
                 break;
+            case 'N':
+                denoiseMemory = atoi(argv[arg++]);
+                break;
             case 'b':
                 brightness = atof(argv[arg++]);
                 break;
@@ -184,6 +197,12 @@ Options::setArguments(int argc, const char **argv) {
             case 'm':
                 med_passes = atoi(argv[arg++]);
                 break;
+            case 'J':
+                threads = atoi(argv[arg++]);
+                break;
+            case 'L':
+                tileMemory = atoi(argv[arg++]);
+                break;
             case 'H':
                 highlight = atoi(argv[arg++]);
                 break;
@@ -262,6 +281,12 @@ Options::setArguments(int argc, const char **argv) {
             case 'T':
                 outputTiff = 1;
                 break;
+            case 'F':
+                fusedOutput = 1;
+                break;
+            case 'Y':
+                planarImage = 1;
+                break;
             case '4':
                 gammaParameters[0] = gammaParameters[1] = noAutoBright = 1;
             case '6':
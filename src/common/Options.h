@@ -44,6 +44,11 @@ class Options {
     int outputTiff;
     int med_passes;
     int noAutoBright;
+    int threads; // Workers for the parallel decoding steps, 0 for one per hardware thread
+    int tileMemory; // KB the X-Trans tile buffers of all workers should fit in, 0 for the default tile size
+    int planarImage; // Move the image to a planar buffer for the stages that take one
+    int fusedOutput; // Convert to output colors while writing the image
+    int denoiseMemory; // MB the wavelet_denoise() buffers should fit in, 0 to denoise the whole image at once
     unsigned greyBox[4];
     float userMul[4];
 
@@ -52,6 +57,6 @@ class Options {
     int setArguments(int argc, const char **argv);
 };
 
-extern Options *OPTIONS_values; // Configurations from program arguments
+extern thread_local Options *OPTIONS_values; // Configurations from program arguments
 
 #endif
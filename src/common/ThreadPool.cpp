@@ -0,0 +1,97 @@
+#include "ThreadPool.h"
+
+/*
+threads is the number of workers, calling thread included. 0 or less uses one per hardware thread.
+*/
+ThreadPool::ThreadPool(int threads) : task(nullptr), next(0), jobs(0), count(0), busy(0), generation(0),
+                                      stopping(false) {
+    if ( threads <= 0 ) {
+        threads = (int)std::thread::hardware_concurrency();
+    }
+    workers = threads > 0 ? threads : 1;
+}
+
+ThreadPool::~ThreadPool() {
+    int i;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for ( i = 0; i < (int)helpers.size(); i++ ) {
+        helpers[i].join();
+    }
+}
+
+int
+ThreadPool::size() const {
+    return workers;
+}
+
+/*
+Body of the helper thread that is worker worker: waits for each run, takes jobs from it when the run has
+that many workers and tells the calling thread when it is out of jobs.
+*/
+void
+ThreadPool::help(int worker) {
+    std::unique_lock<std::mutex> guard(lock);
+    unsigned seen = 0;
+    int job;
+
+    for ( ;; ) {
+        wake.wait(guard, [&] { return stopping || generation != seen; });
+        if ( stopping ) {
+            return;
+        }
+        seen = generation;
+        if ( worker >= count ) {
+            continue;
+        }
+        guard.unlock();
+        while ( (job = next++) < jobs ) {
+            (*task)(job, worker);
+        }
+        guard.lock();
+        if ( !--busy ) {
+            done.notify_one();
+        }
+    }
+}
+
+/*
+Calls task(job, worker) for every job in [0, jobs) and returns when all of them are done. Jobs are
+handed out in increasing order to whichever worker is free; worker, in [0, size()), identifies the
+worker running the job, for tasks keeping a buffer per worker. A single job, or a pool of one worker,
+runs on the calling thread alone.
+*/
+void
+ThreadPool::run(int jobs, const std::function<void(int job, int worker)> &task) {
+    int job;
+    int i;
+
+    if ( workers < 2 || jobs < 2 ) {
+        for ( job = 0; job < jobs; job++ ) {
+            task(job, 0);
+        }
+        return;
+    }
+    for ( i = (int)helpers.size() + 1; i < workers; i++ ) {
+        helpers.emplace_back(&ThreadPool::help, this, i);
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        this->task = &task;
+        this->jobs = jobs;
+        count = workers < jobs ? workers : jobs;
+        busy = count - 1;
+        next = 0;
+        generation++;
+    }
+    wake.notify_all();
+    while ( (job = next++) < jobs ) {
+        task(job, 0);
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [&] { return !busy; });
+}
@@ -0,0 +1,47 @@
+#ifndef __THREAD_POOL__
+#define __THREAD_POOL__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Runs the independent jobs of a decoding step (slices, tiles, bands of rows) on a set of workers: the
+ * calling thread and helper threads started by the first run() that needs them and kept waiting for the
+ * next one until the pool is destroyed, so a step can call run() many times.
+ *
+ * Helper threads do not see the thread_local decoding state (see DecodeContext): a job gets everything
+ * it reads or writes from the task, which has to capture it on the calling thread. Jobs must not call
+ * inputOutputError() or anything that may longjmp to `failure`; errors are counted by the job and
+ * reported by the caller once run() returns.
+ */
+class ThreadPool {
+  private:
+    int workers;
+    std::vector<std::thread> helpers;
+    std::mutex lock;
+    std::condition_variable wake; // A run started or the pool is stopping
+    std::condition_variable done; // The last helper of a run finished
+    const std::function<void(int job, int worker)> *task;
+    std::atomic<int> next;
+    int jobs;
+    int count; // Workers taking part in the current run
+    int busy; // Helpers of the current run still working
+    unsigned generation; // Runs started
+    bool stopping;
+
+    void help(int worker);
+
+  public:
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    int size() const;
+    void run(int jobs, const std::function<void(int job, int worker)> &task);
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "cpuFeatures.h"
+
+static unsigned
+detectCpuFeatures() {
+    unsigned features = 0;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports("sse2") ) {
+        features |= CPU_SSE2;
+    }
+    if ( __builtin_cpu_supports("sse4.1") ) {
+        features |= CPU_SSE41;
+    }
+    if ( __builtin_cpu_supports("avx2") ) {
+        features |= CPU_AVX2;
+    }
+#endif
+    return features;
+}
+
+unsigned
+cpuFeatures() {
+    static const unsigned features = detectCpuFeatures();
+
+    return features;
+}
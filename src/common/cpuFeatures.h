@@ -0,0 +1,16 @@
+#ifndef __CPU_FEATURES__
+#define __CPU_FEATURES__
+
+// Instruction sets the SIMD kernels are built for, as flags of cpuFeatures()
+#define CPU_SSE2 1
+#define CPU_SSE41 2
+#define CPU_AVX2 4
+
+/**
+ * Instruction sets of the running CPU among CPU_SSE2, CPU_SSE41 and CPU_AVX2, detected on the first call.
+ * Each module with SIMD kernels picks them from these flags, keeping its own scalar code for a CPU with none
+ * of them or a build without x86 intrinsics, where this returns 0.
+ */
+extern unsigned cpuFeatures();
+
+#endif
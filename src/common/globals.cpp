@@ -1,46 +1,48 @@
 #include "globals.h"
 
-short GLOBAL_endianOrder;
-unsigned GLOBAL_flipsMask;
-unsigned GLOBAL_dngVersion;
-unsigned GLOBAL_loadFlags;
-unsigned *GLOBAL_outputIccProfile;
-char GLOBAL_bayerPatternLabels[5];
-unsigned GLOBAL_colorTransformForRaw;
-void (*CALLBACK_loadThumbnailRawData)();
+thread_local short GLOBAL_endianOrder;
+thread_local unsigned GLOBAL_flipsMask;
+thread_local unsigned GLOBAL_dngVersion;
+thread_local unsigned GLOBAL_loadFlags;
+thread_local unsigned *GLOBAL_outputIccProfile;
+thread_local char GLOBAL_bayerPatternLabels[5];
+thread_local unsigned GLOBAL_colorTransformForRaw;
+thread_local void (*CALLBACK_loadThumbnailRawData)();
 
-unsigned short (*GLOBAL_image)[4];
-char GLOBAL_make[64];
-char GLOBAL_model[64];
-off_t GLOBAL_meta_offset;
-float GLOBAL_cam_mul[4];
+thread_local unsigned short (*GLOBAL_image)[4];
+thread_local struct ImageBuffer GLOBAL_planarImage;
+thread_local char GLOBAL_make[64];
+thread_local char GLOBAL_model[64];
+thread_local off_t GLOBAL_meta_offset;
+thread_local float GLOBAL_cam_mul[4];
 
-unsigned short cblack[4102];
-unsigned tiff_samples;
-unsigned short top_margin;
-unsigned short left_margin;
-unsigned mix_green;
-float pre_mul[4];
-float flash_used;
-float rgb_cam[3][4];
-float canon_ev;
-unsigned tiff_compress;
-unsigned short cr2_slice[3];
-off_t strip_offset;
-unsigned is_raw;
-unsigned tile_width;
-unsigned tile_length;
-unsigned thumb_misc;
-unsigned short height;
-unsigned short width;
-char model2[64];
-unsigned unique_id;
-unsigned short sraw_mul[4];
-unsigned thumb_length;
-unsigned short thumb_width;
-unsigned short thumb_height;
-unsigned meta_length;
-unsigned kodak_cbpp;
-jmp_buf failure;
+thread_local unsigned short cblack[4102];
+thread_local unsigned tiff_samples;
+thread_local unsigned short top_margin;
+thread_local unsigned short left_margin;
+thread_local unsigned mix_green;
+thread_local float pre_mul[4];
+thread_local float flash_used;
+thread_local float rgb_cam[3][4];
+thread_local float canon_ev;
+thread_local unsigned tiff_compress;
+thread_local unsigned short cr2_slice[3];
+thread_local off_t strip_offset;
+thread_local unsigned is_raw;
+thread_local unsigned tile_width;
+thread_local unsigned tile_length;
+thread_local unsigned thumb_misc;
+thread_local unsigned short height;
+thread_local unsigned short width;
+thread_local char model2[64];
+thread_local unsigned unique_id;
+thread_local unsigned short sraw_mul[4];
+thread_local unsigned thumb_length;
+thread_local unsigned short thumb_width;
+thread_local unsigned short thumb_height;
+thread_local char *meta_data;
+thread_local unsigned meta_length;
+thread_local unsigned kodak_cbpp;
+thread_local jmp_buf failure;
 
-struct ph1 ph1;
+thread_local struct ph1 ph1;
@@ -4,13 +4,20 @@
 #include <cstdio>
 #include <csetjmp>
 
+#include "../imageHandling/ImageBuffer.h"
+
+/*
+All the state below describes the raw file being decoded. It is thread_local: every thread decoding
+a file works on its own copy (see DecodeContext), so several files can be decoded concurrently.
+*/
+
 // II in ASCII
 #define LITTLE_ENDIAN_ORDER 0x4949
 
 // MM in ASCII
 #define BIG_ENDIAN_ORDER 0x4D4D
 
-extern short GLOBAL_endianOrder; // LITTLE_ENDIAN_ORDER or BIG_ENDIAN_ORDER
+extern thread_local short GLOBAL_endianOrder; // LITTLE_ENDIAN_ORDER or BIG_ENDIAN_ORDER
 
 /*
 Flips is a set of bits with several flags.
@@ -18,57 +25,59 @@ Flips is a set of bits with several flags.
 00000010 (0x02): Flip GLOBAL_image in Y
 00000100 (0x04): Rotate GLOBAL_image by 90 degrees by swapping height and width.
 */
-extern unsigned GLOBAL_flipsMask;
+extern thread_local unsigned GLOBAL_flipsMask;
 
 // Used only on persistence/readers
-extern unsigned GLOBAL_dngVersion;
-extern unsigned GLOBAL_loadFlags;
+extern thread_local unsigned GLOBAL_dngVersion;
+extern thread_local unsigned GLOBAL_loadFlags;
 
 // Used only on imageProcess, pending to handle the per-GLOBAL_image initialization
-extern unsigned *GLOBAL_outputIccProfile;
+extern thread_local unsigned *GLOBAL_outputIccProfile;
 
 // Others ( used everywhere :( )
-extern char GLOBAL_bayerPatternLabels[5];
+extern thread_local char GLOBAL_bayerPatternLabels[5];
 
 // 0: will map to RGB or custom (raw), non-0: map from sRGB/Adobe/Wide/ProPhoto/XYZ/ACES (non-raw)
-extern unsigned GLOBAL_colorTransformForRaw;
+extern thread_local unsigned GLOBAL_colorTransformForRaw;
 
 // Others
-extern void (*CALLBACK_loadThumbnailRawData)();
-
-extern unsigned short (*GLOBAL_image)[4];
-extern char GLOBAL_make[64];
-extern char GLOBAL_model[64];
-extern off_t GLOBAL_meta_offset;
-extern float GLOBAL_cam_mul[4];
-
-extern unsigned short cblack[4102];
-extern unsigned tiff_samples;
-extern unsigned short top_margin;
-extern unsigned short left_margin;
-extern unsigned mix_green;
-extern float pre_mul[4];
-extern float flash_used;
-extern float rgb_cam[3][4];
-extern float canon_ev;
-extern unsigned tiff_compress;
-extern unsigned short cr2_slice[3];
-extern off_t strip_offset;
-extern unsigned is_raw;
-extern unsigned tile_width;
-extern unsigned tile_length;
-extern unsigned thumb_misc;
-extern unsigned short height;
-extern unsigned short width;
-extern char model2[64];
-extern unsigned unique_id;
-extern unsigned short sraw_mul[4];
-extern unsigned thumb_length;
-extern unsigned short thumb_width;
-extern unsigned short thumb_height;
-extern unsigned meta_length;
-extern unsigned kodak_cbpp;
-extern jmp_buf failure;
+extern thread_local void (*CALLBACK_loadThumbnailRawData)();
+
+extern thread_local unsigned short (*GLOBAL_image)[4];
+extern thread_local struct ImageBuffer GLOBAL_planarImage; // The image once made planar, GLOBAL_image is then null
+extern thread_local char GLOBAL_make[64];
+extern thread_local char GLOBAL_model[64];
+extern thread_local off_t GLOBAL_meta_offset;
+extern thread_local float GLOBAL_cam_mul[4];
+
+extern thread_local unsigned short cblack[4102];
+extern thread_local unsigned tiff_samples;
+extern thread_local unsigned short top_margin;
+extern thread_local unsigned short left_margin;
+extern thread_local unsigned mix_green;
+extern thread_local float pre_mul[4];
+extern thread_local float flash_used;
+extern thread_local float rgb_cam[3][4];
+extern thread_local float canon_ev;
+extern thread_local unsigned tiff_compress;
+extern thread_local unsigned short cr2_slice[3];
+extern thread_local off_t strip_offset;
+extern thread_local unsigned is_raw;
+extern thread_local unsigned tile_width;
+extern thread_local unsigned tile_length;
+extern thread_local unsigned thumb_misc;
+extern thread_local unsigned short height;
+extern thread_local unsigned short width;
+extern thread_local char model2[64];
+extern thread_local unsigned unique_id;
+extern thread_local unsigned short sraw_mul[4];
+extern thread_local unsigned thumb_length;
+extern thread_local unsigned short thumb_width;
+extern thread_local unsigned short thumb_height;
+extern thread_local char *meta_data;
+extern thread_local unsigned meta_length;
+extern thread_local unsigned kodak_cbpp;
+extern thread_local jmp_buf failure;
 
 struct ph1 {
     int format;
@@ -82,7 +91,7 @@ struct ph1 {
     float tag_210;
 };
 
-extern struct ph1 ph1;
+extern thread_local struct ph1 ph1;
 
 #ifdef LOCALEDIR
 #include <libintl.h>
@@ -135,6 +135,72 @@ make_decoder(const unsigned char *source) {
     return make_decoder_ref(&source);
 }
 
+/*
+Builds a table resolving, from the next HUFF_DIFF_BITS bits, both a code of huff (as built by
+make_decoder()) and the difference bits following it, already sign extended. Codes whose difference
+does not fit in those bits are left with length 0, and have to be read with huff, which the table
+keeps a pointer to.
+*/
+struct HuffDiffTable *
+make_diff_decoder(const unsigned short *huff, int mode) {
+    struct HuffDiffTable *table;
+    struct HuffDiff *entry;
+    unsigned code;
+    int max = huff[0];
+    int len;
+    int shl;
+    int bits;
+    int diff;
+    int x;
+
+    table = (struct HuffDiffTable *)calloc(1, sizeof *table);
+    memoryError(table, "make_diff_decoder()");
+    table->huff = huff;
+    table->mode = mode;
+    for ( x = 0; x < 1 << HUFF_DIFF_BITS; x++ ) {
+        entry = table->entry + x;
+        if ( max <= HUFF_DIFF_BITS ) {
+            code = huff[1 + (x >> (HUFF_DIFF_BITS - max))];
+        } else {
+            code = huff[1 + (x << (max - HUFF_DIFF_BITS))];
+        }
+        entry->leaf = code;
+        bits = code >> 8;
+        shl = 0;
+        if ( mode == HUFF_DIFF_NIKON ) {
+            len = entry->leaf & 15;
+            shl = entry->leaf >> 4;
+        } else if ( mode == HUFF_DIFF_CANON ) {
+            len = entry->leaf == 0xff ? 0 : entry->leaf & 15;
+        } else {
+            len = entry->leaf;
+        }
+        if ( mode == HUFF_DIFF_LJPEG && len == 16 && bits && bits <= HUFF_DIFF_BITS ) {
+            entry->diff = -32768;
+            entry->length = bits;
+            continue;
+        }
+        if ( !bits || len > 15 || shl > len || bits + len - shl > HUFF_DIFF_BITS ) {
+            continue;
+        }
+        diff = (x >> (HUFF_DIFF_BITS - bits - (len - shl))) & ((1 << (len - shl)) - 1);
+        if ( mode == HUFF_DIFF_NIKON ) {
+            diff = ((diff << 1) + 1) << shl >> 1;
+            if ( len && (diff & (1 << (len - 1))) == 0 ) {
+                diff -= (1 << len) - !shl;
+            }
+        } else if ( len && (diff & (1 << (len - 1))) == 0 ) {
+            diff -= (1 << len) - 1;
+        }
+        if ( !len && !shl ) {
+            diff = 0;
+        }
+        entry->diff = diff;
+        entry->length = bits + len - shl;
+    }
+    return table;
+}
+
 void
 crw_init_tables(unsigned table, unsigned short *huff[2]) {
     static const unsigned char first_tree[3][29] = {
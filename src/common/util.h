@@ -1,12 +1,34 @@
 #ifndef __UTIL__
 #define __UTIL__
 
+// Bits looked ahead by a table from make_diff_decoder()
+#define HUFF_DIFF_BITS 12
+
+// How make_diff_decoder() takes the difference bits following each code
+#define HUFF_DIFF_LJPEG 0 // The leaf is the number of difference bits, 16 stands for -32768 with none
+#define HUFF_DIFF_CANON 1 // The low nibble of the leaf is, except for 0xff which has none, as in canon_load_raw()
+#define HUFF_DIFF_NIKON 2 // The leaf is length | shift << 4, as in nikon_load_raw()
+#define HUFF_DIFF_DNG10 3 // As HUFF_DIFF_LJPEG, but 16 is followed by 16 bits as in DNG 1.0 files
+
+struct HuffDiff {
+    short diff;
+    unsigned char length; // Bits taken by the code and its difference, 0 when they do not fit in the table
+    unsigned char leaf;
+};
+
+struct HuffDiffTable {
+    const unsigned short *huff;
+    int mode;
+    struct HuffDiff entry[1 << HUFF_DIFF_BITS];
+};
+
 extern void memoryError(void *ptr, const char *where);
 extern void pseudoinverse(double (*in)[3], double (*out)[3], int size);
 extern double clampUnitInterval(double x);
 extern unsigned short clampRange(unsigned short value, unsigned short lowerLimit, unsigned short upperLimit);
 extern unsigned short * make_decoder(const unsigned char *source);
 extern unsigned short * make_decoder_ref(const unsigned char **source);
+extern struct HuffDiffTable *make_diff_decoder(const unsigned short *huff, int mode);
 extern void crw_init_tables(unsigned table, unsigned short *huff[2]);
 
 #endif
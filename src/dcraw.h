@@ -0,0 +1,49 @@
+#ifndef __DCRAW__
+#define __DCRAW__
+
+#include <cstddef>
+
+#include "common/Options.h"
+
+/**
+ * Parameters of a decode. They are the same settings the command line tool builds from its arguments.
+ */
+typedef Options DecodeParams;
+
+/**
+ * A decoded image: height rows of width pixels, each with `colors` meaningful channels out of 4, in the
+ * output color space selected by the parameters (the buffer written by write_ppm_tiff, before gamma
+ * and flipping). `flip` is the orientation still to apply, in the same encoding as GLOBAL_flipsMask.
+ * The pixels are owned by the caller, who has to call release() on them.
+ */
+class Image16 {
+  public:
+    unsigned short (*pixels)[4];
+    int width;
+    int height;
+    int colors;
+    int flip;
+
+    Image16();
+    void release();
+};
+
+/**
+ * Decodes the raw file contained in buffer on the calling thread. Several threads can decode at the
+ * same time. Returns an image with null pixels when the buffer holds no supported raw image or it is
+ * corrupt.
+ */
+extern Image16 decode(const void *buffer, size_t length, const DecodeParams &params);
+
+// Steps of a decode over GLOBAL_IO_ifp, as run by decode() and by the command line tool
+extern int identifyRawFile();
+extern int timestampRawFile();
+extern int selectThumbnail();
+extern int embeddedThumbnailSelected();
+extern int prepareRawImage();
+extern void loadRawImage();
+extern void processRawImage();
+extern const char *outputFileExtension();
+extern void writeOutputFile();
+
+#endif
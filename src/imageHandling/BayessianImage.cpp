@@ -4,48 +4,57 @@
 #include "BayessianImage.h"
 
 // Image model
-BayessianImage THE_image;
-unsigned IMAGE_colors;
-unsigned IMAGE_filters;
-unsigned short IMAGE_shrink;
-unsigned short IMAGE_iheight;
-unsigned short IMAGE_iwidth;
+thread_local BayessianImage THE_image;
+thread_local unsigned IMAGE_colors;
+thread_local unsigned IMAGE_filters;
+thread_local unsigned short IMAGE_shrink;
+thread_local unsigned short IMAGE_iheight;
+thread_local unsigned short IMAGE_iwidth;
 
-BayessianImage::BayessianImage() {
-    bitsPerSample = 0;
-    rawData = nullptr;
-    height = 0;
-    width = 0;
-}
-
-BayessianImage::~BayessianImage() {
+void
+adobe_copy_target(struct AdobeCopyTarget *target) {
+    target->rawData = THE_image.rawData;
+    target->image = GLOBAL_image;
+    target->curve = GAMMA_curveFunctionLookupTable;
+    target->height = THE_image.height;
+    target->width = THE_image.width;
+    target->samples = tiff_samples;
+    target->skipFirst = tiff_samples == 2 && OPTIONS_values->shotSelect;
 }
 
 void
-adobe_copy_pixel(unsigned row, unsigned col, unsigned short **rp) {
-    int c;
+adobe_copy_pixel(const struct AdobeCopyTarget *target, unsigned row, unsigned col, unsigned short **rp) {
+    unsigned c;
 
-    if ( tiff_samples == 2 && OPTIONS_values->shotSelect ) {
+    if ( target->skipFirst ) {
         (*rp)++;
     }
-    if ( THE_image.rawData ) {
-        if ( row < THE_image.height && col < THE_image.width ) {
-            RAW(row, col) = GAMMA_curveFunctionLookupTable[**rp];
+    if ( target->rawData ) {
+        if ( row < target->height && col < target->width ) {
+            target->rawData[row * target->width + col] = target->curve[**rp];
         }
-        *rp += tiff_samples;
+        *rp += target->samples;
     } else {
-        if ( row < THE_image.height && col < THE_image.width ) {
-            for ( c = 0; c < tiff_samples; c++ ) {
-                GLOBAL_image[row * THE_image.width + col][c] = GAMMA_curveFunctionLookupTable[(*rp)[c]];
+        if ( row < target->height && col < target->width ) {
+            for ( c = 0; c < target->samples; c++ ) {
+                target->image[row * target->width + col][c] = target->curve[(*rp)[c]];
             }
         }
-        *rp += tiff_samples;
+        *rp += target->samples;
     }
-    if ( tiff_samples == 2 && OPTIONS_values->shotSelect ) {
+    if ( target->skipFirst ) {
         (*rp)--;
     }
 }
 
+void
+adobe_copy_pixel(unsigned row, unsigned col, unsigned short **rp) {
+    struct AdobeCopyTarget target;
+
+    adobe_copy_target(&target);
+    adobe_copy_pixel(&target, row, col, rp);
+}
+
 int
 raw(unsigned row, unsigned col) {
     return (row < THE_image.height && col < THE_image.width) ? RAW(row, col) : 0;
@@ -24,8 +24,8 @@ class BayessianImage {
     unsigned short height;
     unsigned short width;
 
-    BayessianImage();
-    ~BayessianImage();
+    // Constant initialization keeps the thread_local THE_image free of dynamic initialization
+    constexpr BayessianImage(): rawData(0), bitsPerSample(0), height(0), width(0) {}
 };
 
 /*
@@ -79,12 +79,28 @@ All RGB cameras use one of these Bayer grids:
 #define BAYER2(row, col) \
     GLOBAL_image[((row) >> IMAGE_shrink)*IMAGE_iwidth + ((col) >> IMAGE_shrink)][fcol(row,col)]
 
-extern BayessianImage THE_image;
-extern unsigned IMAGE_colors;
-extern unsigned IMAGE_filters;
-extern unsigned short IMAGE_shrink;
-extern unsigned short IMAGE_iheight;
-extern unsigned short IMAGE_iwidth;
+/**
+ * Where adobe_copy_pixel() writes the pixels of a DNG, taken from the decoding state of the current thread
+ * by adobe_copy_target(), so helper threads can copy pixels as well.
+ */
+struct AdobeCopyTarget {
+    unsigned short *rawData;
+    unsigned short (*image)[4];
+    const unsigned short *curve;
+    unsigned height;
+    unsigned width;
+    unsigned samples;
+    int skipFirst; // Second shot of two sample pixels
+};
+
+extern thread_local BayessianImage THE_image;
+extern thread_local unsigned IMAGE_colors;
+extern thread_local unsigned IMAGE_filters;
+extern thread_local unsigned short IMAGE_shrink;
+extern thread_local unsigned short IMAGE_iheight;
+extern thread_local unsigned short IMAGE_iwidth;
+extern void adobe_copy_target(struct AdobeCopyTarget *target);
+extern void adobe_copy_pixel(const struct AdobeCopyTarget *target, unsigned row, unsigned col, unsigned short **rp);
 extern void adobe_copy_pixel(unsigned row, unsigned col, unsigned short **rp);
 extern int raw(unsigned row, unsigned col);
 
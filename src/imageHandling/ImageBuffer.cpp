@@ -0,0 +1,110 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "../common/util.h"
+#include "ImageBuffer.h"
+
+void
+imageBufferView(struct ImageBuffer *buffer, unsigned short (*pixels)[4], int width, int height) {
+    int c;
+
+    buffer->layout = IMAGE_BUFFER_INTERLEAVED;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->channels = 4;
+    buffer->step = 4;
+    buffer->pitch = 4L * width;
+    for ( c = 0; c < 4; c++ ) {
+        buffer->planes[c] = pixels ? pixels[0] + c : nullptr;
+    }
+    buffer->memory = nullptr;
+}
+
+/*
+A planar row takes at most the bytes of the interleaved one, so row row can be moved to its place once it
+has been copied out: rows above it are already moved and rows below it start after its new end.
+*/
+void
+imageBufferToPlanar(struct ImageBuffer *buffer, unsigned short (*pixels)[4], int width, int height, int colors) {
+    long columns = (width + IMAGE_BUFFER_ALIGN / 2 - 1) & ~(long) (IMAGE_BUFFER_ALIGN / 2 - 1);
+    unsigned short (*line)[4];
+    unsigned short *base = pixels[0];
+    unsigned short *plane;
+    long bytes;
+    int row;
+    int col;
+    int c;
+
+    if ( columns * colors > 4L * width ) {
+        columns = width;
+    }
+    line = (unsigned short (*)[4]) malloc(width * sizeof *line);
+    memoryError(line, "imageBufferToPlanar()");
+    for ( row = 0; row < height; row++ ) {
+        memcpy(line, pixels + (long) row * width, width * sizeof *line);
+        for ( c = 0; c < colors; c++ ) {
+            plane = base + (row * colors + c) * columns;
+            for ( col = 0; col < width; col++ ) {
+                plane[col] = line[col][c];
+            }
+        }
+    }
+    free(line);
+    bytes = columns * colors * height * sizeof *base;
+    buffer->memory = realloc(base, bytes ? bytes : 1);
+    if ( !buffer->memory ) {
+        buffer->memory = base;
+    }
+    buffer->layout = IMAGE_BUFFER_PLANAR;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->channels = colors;
+    buffer->step = 1;
+    buffer->pitch = columns * colors;
+    for ( c = 0; c < 4; c++ ) {
+        buffer->planes[c] = c < colors ? (unsigned short *) buffer->memory + c * columns : nullptr;
+    }
+}
+
+/*
+The reverse of imageBufferToPlanar(), from the last row up: an interleaved row starts at or after its
+planar one and ends before the next planar one
+*/
+unsigned short (*
+imageBufferToInterleaved(struct ImageBuffer *buffer))[4] {
+    unsigned short (*pixels)[4];
+    unsigned short *line;
+    long offset[4];
+    long bytes = (long) buffer->width * buffer->height * sizeof *pixels;
+    int row;
+    int col;
+    int c;
+
+    for ( c = 0; c < buffer->channels; c++ ) {
+        offset[c] = buffer->planes[c] - buffer->planes[0];
+    }
+    line = (unsigned short *) malloc(buffer->pitch * sizeof *line);
+    memoryError(line, "imageBufferToInterleaved()");
+    pixels = (unsigned short (*)[4]) realloc(buffer->memory, bytes ? bytes : 1);
+    if ( !pixels ) {
+        free(line);
+        memoryError(nullptr, "imageBufferToInterleaved()");
+    }
+    for ( row = buffer->height - 1; row >= 0; row-- ) {
+        memcpy(line, (unsigned short *) pixels + row * buffer->pitch, buffer->pitch * sizeof *line);
+        for ( col = 0; col < buffer->width; col++ ) {
+            for ( c = 0; c < 4; c++ ) {
+                pixels[(long) row * buffer->width + col][c] = c < buffer->channels ? line[offset[c] + col] : 0;
+            }
+        }
+    }
+    free(line);
+    memset(buffer, 0, sizeof *buffer);
+    return pixels;
+}
+
+void
+imageBufferRelease(struct ImageBuffer *buffer) {
+    free(buffer->memory);
+    memset(buffer, 0, sizeof *buffer);
+}
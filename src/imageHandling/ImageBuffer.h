@@ -0,0 +1,64 @@
+#ifndef __IMAGE_BUFFER__
+#define __IMAGE_BUFFER__
+
+// Layouts of an ImageBuffer
+#define IMAGE_BUFFER_INTERLEAVED 0 // Four samples per pixel, as in GLOBAL_image
+#define IMAGE_BUFFER_PLANAR 1 // One plane per color
+
+// Bytes planar rows are aligned to
+#define IMAGE_BUFFER_ALIGN 64
+
+/**
+ * The image seen by the stages that take either layout. Sample c of the pixel at (row, col) is
+ * planes[c][row * pitch + col * step]:
+ * - an interleaved buffer is a view of unsigned short (*)[4] pixels: four planes one sample apart, step 4
+ *   and pitch 4 * width.
+ * - a planar buffer owns its memory: one plane per color, step 1, each row holding the row of every plane
+ *   one after the other, padded to a multiple of IMAGE_BUFFER_ALIGN bytes when that still fits in the
+ *   interleaved pixels. With three colors it takes a quarter less memory than the interleaved one.
+ *
+ * A zero initialized ImageBuffer is empty, so it can be a thread_local global.
+ */
+struct ImageBuffer {
+    int layout;
+    int width;
+    int height;
+    int channels; // Planes
+    int step;
+    long pitch;
+    unsigned short *planes[4];
+    void *memory; // Allocation of a planar buffer, null for a view
+};
+
+/**
+ * Plane c of row row
+ */
+inline unsigned short *
+imageBufferRow(const struct ImageBuffer *buffer, int row, int c) {
+    return buffer->planes[c] + row * buffer->pitch;
+}
+
+/**
+ * Makes buffer an interleaved view of pixels
+ */
+extern void imageBufferView(struct ImageBuffer *buffer, unsigned short (*pixels)[4], int width, int height);
+
+/**
+ * Makes buffer a planar buffer of the first colors samples of each pixel, moved a row at a time within
+ * the memory of pixels, which has to come from malloc(): the buffer takes it over and shrinks it to
+ * what the planes need, so the image is never held twice.
+ */
+extern void imageBufferToPlanar(struct ImageBuffer *buffer, unsigned short (*pixels)[4], int width, int height, int colors);
+
+/**
+ * Moves a planar buffer back to interleaved pixels, within its own memory grown to fit them, the samples
+ * it has no plane for being zero. The buffer is left empty and the caller owns the pixels.
+ */
+extern unsigned short (*imageBufferToInterleaved(struct ImageBuffer *buffer))[4];
+
+/**
+ * Frees the memory of a planar buffer and leaves it empty
+ */
+extern void imageBufferRelease(struct ImageBuffer *buffer);
+
+#endif
@@ -1,3 +1,8 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AHD_INTERPOLATOR_X86
+#include <immintrin.h>
+#endif
+
 #include <cstdio>
 #include <cstring>
 
@@ -6,5 +11,222 @@
 #include "../colorRepresentation/cielab.h"
 #include "../common/mathMacros.h"
 #include "../common/util.h"
+#include "../common/cpuFeatures.h"
 #include "AhdInterpolator.h"
 
+// Builds a prefix of the row, returns the number of pixels done
+typedef int (*HomogeneityRowKernel)(const short *lab[2][3], int stride, char *homo[2], int count);
+
+/*
+Pixels first to count - 1 one at a time, the way ahd_interpolate() always did. Squares of the a and b
+differences can go past INT_MAX, so they are summed as unsigned, wrapping as the vector code does.
+*/
+static void
+homogeneityScalar(const short *lab[2][3], int stride, char *homo[2], int first, int count) {
+    const int dir[4] = {-1, 1, -stride, stride};
+    unsigned ldiff[2][4];
+    unsigned abdiff[2][4];
+    unsigned leps;
+    unsigned abeps;
+    int col;
+    int d;
+    int i;
+
+    for ( col = first; col < count; col++ ) {
+        for ( d = 0; d < 2; d++ ) {
+            for ( i = 0; i < 4; i++ ) {
+                ldiff[d][i] = ABS(lab[d][0][col] - lab[d][0][col + dir[i]]);
+                abdiff[d][i] = SQR((unsigned) (lab[d][1][col] - lab[d][1][col + dir[i]]))
+                               + SQR((unsigned) (lab[d][2][col] - lab[d][2][col + dir[i]]));
+            }
+        }
+        leps = MIN(MAX(ldiff[0][0], ldiff[0][1]),
+                   MAX(ldiff[1][2], ldiff[1][3]));
+        abeps = MIN(MAX(abdiff[0][0], abdiff[0][1]),
+                    MAX(abdiff[1][2], abdiff[1][3]));
+        for ( d = 0; d < 2; d++ ) {
+            homo[d][col] = 0;
+            for ( i = 0; i < 4; i++ ) {
+                if ( ldiff[d][i] <= leps && abdiff[d][i] <= abeps ) {
+                    homo[d][col]++;
+                }
+            }
+        }
+    }
+}
+
+#ifdef AHD_INTERPOLATOR_X86
+
+/*
+SSE2 has neither unsigned 32-bit comparisons nor 32-bit products: the differences are kept with their
+sign bit flipped, so that signed comparisons order them as unsigned, and squares are made of two 64-bit
+products.
+*/
+__attribute__((target("sse2")))
+static inline __m128i
+loadLanesSse2(const short *source) {
+    return _mm_srai_epi32(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *) source), _mm_loadl_epi64((const __m128i *) source)), 16);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+absSse2(__m128i x) {
+    __m128i sign = _mm_srai_epi32(x, 31);
+
+    return _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+squareSse2(__m128i x) {
+    __m128i even = _mm_mul_epu32(x, x);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(x, 32));
+
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+maxSse2(__m128i x, __m128i y) {
+    __m128i greater = _mm_cmpgt_epi32(x, y);
+
+    return _mm_or_si128(_mm_and_si128(greater, x), _mm_andnot_si128(greater, y));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+minSse2(__m128i x, __m128i y) {
+    __m128i greater = _mm_cmpgt_epi32(x, y);
+
+    return _mm_or_si128(_mm_and_si128(greater, y), _mm_andnot_si128(greater, x));
+}
+
+__attribute__((target("sse2")))
+static int
+homogeneitySse2(const short *lab[2][3], int stride, char *homo[2], int count) {
+    const int dir[4] = {-1, 1, -stride, stride};
+    const __m128i flip = _mm_set1_epi32((int) 0x80000000);
+    __m128i ldiff[2][4];
+    __m128i abdiff[2][4];
+    __m128i center[3];
+    __m128i leps;
+    __m128i abeps;
+    __m128i counts[2];
+    int bytes;
+    int col;
+    int d;
+    int i;
+
+    for ( col = 0; col + 4 <= count; col += 4 ) {
+        for ( d = 0; d < 2; d++ ) {
+            center[0] = loadLanesSse2(lab[d][0] + col);
+            center[1] = loadLanesSse2(lab[d][1] + col);
+            center[2] = loadLanesSse2(lab[d][2] + col);
+            for ( i = 0; i < 4; i++ ) {
+                ldiff[d][i] = _mm_xor_si128(absSse2(_mm_sub_epi32(center[0], loadLanesSse2(lab[d][0] + col + dir[i]))), flip);
+                abdiff[d][i] = _mm_xor_si128(_mm_add_epi32(
+                    squareSse2(absSse2(_mm_sub_epi32(center[1], loadLanesSse2(lab[d][1] + col + dir[i])))),
+                    squareSse2(absSse2(_mm_sub_epi32(center[2], loadLanesSse2(lab[d][2] + col + dir[i]))))), flip);
+            }
+        }
+        leps = minSse2(maxSse2(ldiff[0][0], ldiff[0][1]), maxSse2(ldiff[1][2], ldiff[1][3]));
+        abeps = minSse2(maxSse2(abdiff[0][0], abdiff[0][1]), maxSse2(abdiff[1][2], abdiff[1][3]));
+        for ( d = 0; d < 2; d++ ) {
+            // One for each neighbour within both limits
+            counts[d] = _mm_setzero_si128();
+            for ( i = 0; i < 4; i++ ) {
+                counts[d] = _mm_add_epi32(counts[d], _mm_andnot_si128(
+                    _mm_or_si128(_mm_cmpgt_epi32(ldiff[d][i], leps), _mm_cmpgt_epi32(abdiff[d][i], abeps)),
+                    _mm_set1_epi32(1)));
+            }
+            counts[d] = _mm_packs_epi32(counts[d], counts[d]);
+            bytes = _mm_cvtsi128_si32(_mm_packus_epi16(counts[d], counts[d]));
+            memcpy(homo[d] + col, &bytes, 4);
+        }
+    }
+    return col;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+loadLanesAvx2(const short *source) {
+    return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) source));
+}
+
+/*
+Whether each unsigned lane of x is at most the one of limit, as a 0 / 1 lane
+*/
+__attribute__((target("avx2")))
+static inline __m256i
+withinAvx2(__m256i x, __m256i limit) {
+    return _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(x, limit), limit), _mm256_set1_epi32(1));
+}
+
+__attribute__((target("avx2")))
+static int
+homogeneityAvx2(const short *lab[2][3], int stride, char *homo[2], int count) {
+    const int dir[4] = {-1, 1, -stride, stride};
+    __m256i ldiff[2][4];
+    __m256i abdiff[2][4];
+    __m256i center[3];
+    __m256i delta[2];
+    __m256i leps;
+    __m256i abeps;
+    __m256i counts;
+    __m128i packed;
+    int col;
+    int d;
+    int i;
+
+    for ( col = 0; col + 8 <= count; col += 8 ) {
+        for ( d = 0; d < 2; d++ ) {
+            center[0] = loadLanesAvx2(lab[d][0] + col);
+            center[1] = loadLanesAvx2(lab[d][1] + col);
+            center[2] = loadLanesAvx2(lab[d][2] + col);
+            for ( i = 0; i < 4; i++ ) {
+                ldiff[d][i] = _mm256_abs_epi32(_mm256_sub_epi32(center[0], loadLanesAvx2(lab[d][0] + col + dir[i])));
+                delta[0] = _mm256_sub_epi32(center[1], loadLanesAvx2(lab[d][1] + col + dir[i]));
+                delta[1] = _mm256_sub_epi32(center[2], loadLanesAvx2(lab[d][2] + col + dir[i]));
+                abdiff[d][i] = _mm256_add_epi32(_mm256_mullo_epi32(delta[0], delta[0]), _mm256_mullo_epi32(delta[1], delta[1]));
+            }
+        }
+        leps = _mm256_min_epu32(_mm256_max_epu32(ldiff[0][0], ldiff[0][1]), _mm256_max_epu32(ldiff[1][2], ldiff[1][3]));
+        abeps = _mm256_min_epu32(_mm256_max_epu32(abdiff[0][0], abdiff[0][1]), _mm256_max_epu32(abdiff[1][2], abdiff[1][3]));
+        for ( d = 0; d < 2; d++ ) {
+            counts = _mm256_setzero_si256();
+            for ( i = 0; i < 4; i++ ) {
+                counts = _mm256_add_epi32(counts, _mm256_and_si256(withinAvx2(ldiff[d][i], leps), withinAvx2(abdiff[d][i], abeps)));
+            }
+            packed = _mm_packs_epi32(_mm256_castsi256_si128(counts), _mm256_extracti128_si256(counts, 1));
+            _mm_storel_epi64((__m128i *) (homo[d] + col), _mm_packus_epi16(packed, packed));
+        }
+    }
+    return col;
+}
+
+#endif
+
+static HomogeneityRowKernel
+selectKernel() {
+#ifdef AHD_INTERPOLATOR_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        return homogeneityAvx2;
+    }
+    if ( cpuFeatures() & CPU_SSE2 ) {
+        return homogeneitySse2;
+    }
+#endif
+    return nullptr;
+}
+
+void
+ahdHomogeneityRow(const short *lab[2][3], int stride, char *homo[2], int count) {
+    static const HomogeneityRowKernel kernel = selectKernel();
+    int done = 0;
+
+    if ( kernel ) {
+        done = kernel(lab, stride, homo, count);
+    }
+    homogeneityScalar(lab, stride, homo, done, count);
+}
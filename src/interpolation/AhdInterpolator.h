@@ -3,5 +3,14 @@
 
 #include "Interpolator.h"
 
+/**
+ * Builds count pixels of a row of the AHD homogeneity maps, as ahd_interpolate() does. lab[d][k] points
+ * to the first pixel in plane k (L, a or b) of the CIELab image interpolated in direction d (0 horizontal,
+ * 1 vertical), whose rows are stride pixels apart. homo[d] gets the number of neighbours of each pixel,
+ * out of four, whose color is as close to it as the least homogeneous direction allows.
+ *
+ * Eight or four pixels are done at a time with AVX2 or SSE2 when the processor has them.
+ */
+extern void ahdHomogeneityRow(const short *lab[2][3], int stride, char *homo[2], int count);
 
 #endif
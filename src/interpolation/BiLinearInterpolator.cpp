@@ -1,6 +1,135 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BILINEAR_INTERPOLATOR_X86
+#include <immintrin.h>
+#endif
+
 #include <cstdio>
 #include <cstring>
 
 #include "../imageHandling/BayessianImage.h"
+#include "../common/cpuFeatures.h"
 #include "BiLinearInterpolator.h"
 
+// Interpolates a prefix of the pixels, returns the first one it did not do
+typedef int (*BilinearKernel)(const unsigned short (*above)[4], unsigned short (*row)[4], const unsigned short (*below)[4], const int weights[4][2][4], int first, int last);
+
+static void
+bilinearScalar(const unsigned short (*above)[4], unsigned short (*row)[4], const unsigned short (*below)[4], const int weights[4][2][4], int first, int last) {
+    const int *w[4];
+    int col;
+    int c;
+
+    for ( col = first; col < last; col++ ) {
+        for ( c = 0; c < 4; c++ ) {
+            w[c] = weights[c][col & 1];
+        }
+        for ( c = 0; c < 4; c++ ) {
+            row[col][c] = (w[BILINEAR_HORIZONTAL][c] * (row[col - 1][c] + row[col + 1][c]) +
+                           w[BILINEAR_VERTICAL][c] * (above[col][c] + below[col][c]) +
+                           w[BILINEAR_DIAGONAL][c] * (above[col - 1][c] + above[col + 1][c] + below[col - 1][c] + below[col + 1][c]) +
+                           w[BILINEAR_SELF][c] * row[col][c]) >> 2;
+        }
+    }
+}
+
+#ifdef BILINEAR_INTERPOLATOR_X86
+
+/*
+One pixel per register, four channels in 32-bit lanes
+*/
+__attribute__((target("sse4.1")))
+static inline __m128i
+loadPixelSse41(const unsigned short *pixel) {
+    return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) pixel));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i
+pixelSse41(const unsigned short (*above)[4], const unsigned short (*row)[4], const unsigned short (*below)[4], const __m128i w[4], int col) {
+    __m128i sum;
+
+    sum = _mm_mullo_epi32(w[BILINEAR_HORIZONTAL], _mm_add_epi32(loadPixelSse41(row[col - 1]), loadPixelSse41(row[col + 1])));
+    sum = _mm_add_epi32(sum, _mm_mullo_epi32(w[BILINEAR_VERTICAL], _mm_add_epi32(loadPixelSse41(above[col]), loadPixelSse41(below[col]))));
+    sum = _mm_add_epi32(sum, _mm_mullo_epi32(w[BILINEAR_DIAGONAL], _mm_add_epi32(
+        _mm_add_epi32(loadPixelSse41(above[col - 1]), loadPixelSse41(above[col + 1])),
+        _mm_add_epi32(loadPixelSse41(below[col - 1]), loadPixelSse41(below[col + 1])))));
+    sum = _mm_add_epi32(sum, _mm_mullo_epi32(w[BILINEAR_SELF], loadPixelSse41(row[col])));
+    return _mm_srli_epi32(sum, 2);
+}
+
+__attribute__((target("sse4.1")))
+static int
+bilinearSse41(const unsigned short (*above)[4], unsigned short (*row)[4], const unsigned short (*below)[4], const int weights[4][2][4], int first, int last) {
+    __m128i w[2][4];
+    __m128i low;
+    int col;
+    int t;
+
+    for ( t = 0; t < 4; t++ ) {
+        w[0][t] = _mm_loadu_si128((const __m128i *) weights[t][first & 1]);
+        w[1][t] = _mm_loadu_si128((const __m128i *) weights[t][!(first & 1)]);
+    }
+    for ( col = first; col + 2 <= last; col += 2 ) {
+        low = pixelSse41(above, row, below, w[0], col);
+        _mm_storeu_si128((__m128i *) row[col], _mm_packus_epi32(low, pixelSse41(above, row, below, w[1], col + 1)));
+    }
+    return col;
+}
+
+/*
+Two pixels per register, one in each 128-bit lane
+*/
+__attribute__((target("avx2")))
+static inline __m256i
+loadPixelsAvx2(const unsigned short *pixels) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) pixels));
+}
+
+__attribute__((target("avx2")))
+static int
+bilinearAvx2(const unsigned short (*above)[4], unsigned short (*row)[4], const unsigned short (*below)[4], const int weights[4][2][4], int first, int last) {
+    __m256i w[4];
+    __m256i sum;
+    int col;
+    int t;
+
+    for ( t = 0; t < 4; t++ ) {
+        w[t] = _mm256_setr_m128i(_mm_loadu_si128((const __m128i *) weights[t][first & 1]),
+                                 _mm_loadu_si128((const __m128i *) weights[t][!(first & 1)]));
+    }
+    for ( col = first; col + 2 <= last; col += 2 ) {
+        sum = _mm256_mullo_epi32(w[BILINEAR_HORIZONTAL], _mm256_add_epi32(loadPixelsAvx2(row[col - 1]), loadPixelsAvx2(row[col + 1])));
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(w[BILINEAR_VERTICAL], _mm256_add_epi32(loadPixelsAvx2(above[col]), loadPixelsAvx2(below[col]))));
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(w[BILINEAR_DIAGONAL], _mm256_add_epi32(
+            _mm256_add_epi32(loadPixelsAvx2(above[col - 1]), loadPixelsAvx2(above[col + 1])),
+            _mm256_add_epi32(loadPixelsAvx2(below[col - 1]), loadPixelsAvx2(below[col + 1])))));
+        sum = _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_mullo_epi32(w[BILINEAR_SELF], loadPixelsAvx2(row[col]))), 2);
+        _mm_storeu_si128((__m128i *) row[col], _mm_packus_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1)));
+    }
+    return col;
+}
+
+#endif
+
+static BilinearKernel
+selectKernel() {
+#ifdef BILINEAR_INTERPOLATOR_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        return bilinearAvx2;
+    }
+    if ( cpuFeatures() & CPU_SSE41 ) {
+        return bilinearSse41;
+    }
+#endif
+    return nullptr;
+}
+
+void
+bilinearBayerRow(const unsigned short (*above)[4], unsigned short (*row)[4], const unsigned short (*below)[4], const int weights[4][2][4], int first, int last) {
+    static const BilinearKernel kernel = selectKernel();
+
+    if ( kernel ) {
+        first = kernel(above, row, below, weights, first, last);
+    }
+    bilinearScalar(above, row, below, weights, first, last);
+}
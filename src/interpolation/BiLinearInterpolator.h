@@ -3,4 +3,20 @@
 
 #include "Interpolator.h"
 
+// Terms of a bilinear interpolation weight
+#define BILINEAR_HORIZONTAL 0 // Pixels to the left and right
+#define BILINEAR_VERTICAL 1 // Pixels above and below
+#define BILINEAR_DIAGONAL 2 // The four corners
+#define BILINEAR_SELF 3 // The pixel itself
+
+/**
+ * Bilinear interpolation of pixels first to last - 1 of a row with a 2 x 2 filter pattern, in place. Channel c
+ * of the pixel in column col becomes the sum of the four terms times weights[term][col & 1][c], shifted right
+ * by two. The weights may only take channels the neighbours have kept from the raw data, then the pixels
+ * already done do not change the ones after them.
+ *
+ * Pixels are done two at a time with AVX2 or SSE4.1 when the processor has them.
+ */
+extern void bilinearBayerRow(const unsigned short (*above)[4], unsigned short (*row)[4], const unsigned short (*below)[4], const int weights[4][2][4], int first, int last);
+
 #endif
@@ -1,7 +1,403 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PPG_INTERPOLATOR_X86
+#include <immintrin.h>
+#endif
+
 #include <cstdio>
 
 #include "../imageHandling/BayessianImage.h"
 #include "../common/Options.h"
 #include "../common/mathMacros.h"
+#include "../common/cpuFeatures.h"
 #include "PpgInterpolator.h"
 
+// Each kernel does a prefix of the sites and returns the first site it did not do
+typedef int (*PpgGreenKernel)(const unsigned short *mosaic[7][2], int parity, int first, int last, unsigned short *green);
+typedef int (*PpgGreenSitesKernel)(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *horizontal, unsigned short *vertical);
+typedef int (*PpgDiagonalKernel)(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *out);
+
+struct PpgKernels {
+    PpgGreenKernel green;
+    PpgGreenSitesKernel greenSites;
+    PpgDiagonalKernel diagonal;
+};
+
+/*
+In the scalar code, as in the vector one, other[k - 1] and other[k] are the pixels to the left and right of
+site k: other points to the row of the opposite parity, moved by parity.
+*/
+static void
+greenScalar(const unsigned short *mosaic[7][2], int parity, int first, int last, unsigned short *green) {
+    const unsigned short *same = mosaic[3][parity];
+    const unsigned short *other = mosaic[3][!parity] + parity;
+    int guess[2];
+    int diff[2];
+    int c0;
+    int k;
+
+    for ( k = first; k < last; k++ ) {
+        c0 = same[k];
+        guess[0] = (other[k - 1] + c0 + other[k]) * 2 - same[k - 1] - same[k + 1];
+        diff[0] = (ABS(same[k - 1] - c0) + ABS(same[k + 1] - c0) + ABS(other[k - 1] - other[k])) * 3 +
+                  (ABS(other[k + 1] - other[k]) + ABS(other[k - 2] - other[k - 1])) * 2;
+        guess[1] = (mosaic[2][parity][k] + c0 + mosaic[4][parity][k]) * 2 - mosaic[1][parity][k] - mosaic[5][parity][k];
+        diff[1] = (ABS(mosaic[1][parity][k] - c0) + ABS(mosaic[5][parity][k] - c0) +
+                   ABS(mosaic[2][parity][k] - mosaic[4][parity][k])) * 3 +
+                  (ABS(mosaic[6][parity][k] - mosaic[4][parity][k]) + ABS(mosaic[0][parity][k] - mosaic[2][parity][k])) * 2;
+        if ( diff[0] > diff[1] ) {
+            green[k] = ULIM(guess[1] >> 2, mosaic[4][parity][k], mosaic[2][parity][k]);
+        } else {
+            green[k] = ULIM(guess[0] >> 2, other[k], other[k - 1]);
+        }
+    }
+}
+
+static void
+greenSitesScalar(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *horizontal, unsigned short *vertical) {
+    const unsigned short *other = mosaic[1][!parity] + parity;
+    const unsigned short *otherGreen = green[1][!parity] + parity;
+    int g0;
+    int k;
+
+    for ( k = first; k < last; k++ ) {
+        g0 = mosaic[1][parity][k];
+        horizontal[k] = CLIP((other[k - 1] + other[k] + 2 * g0 - otherGreen[k - 1] - otherGreen[k]) >> 1);
+        vertical[k] = CLIP((mosaic[0][parity][k] + mosaic[2][parity][k] + 2 * g0
+                            - green[0][parity][k] - green[2][parity][k]) >> 1);
+    }
+}
+
+/*
+Diagonal 0 goes from up left to down right, diagonal 1 from up right to down left
+*/
+static void
+diagonalScalar(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *out) {
+    const unsigned short *up = mosaic[0][!parity] + parity;
+    const unsigned short *down = mosaic[2][!parity] + parity;
+    const unsigned short *upGreen = green[0][!parity] + parity;
+    const unsigned short *downGreen = green[2][!parity] + parity;
+    int guess[2];
+    int diff[2];
+    int g0;
+    int k;
+
+    for ( k = first; k < last; k++ ) {
+        g0 = green[1][parity][k];
+        diff[0] = ABS(up[k - 1] - down[k]) + ABS(upGreen[k - 1] - g0) + ABS(downGreen[k] - g0);
+        guess[0] = up[k - 1] + down[k] + 2 * g0 - upGreen[k - 1] - downGreen[k];
+        diff[1] = ABS(up[k] - down[k - 1]) + ABS(upGreen[k] - g0) + ABS(downGreen[k - 1] - g0);
+        guess[1] = up[k] + down[k - 1] + 2 * g0 - upGreen[k] - downGreen[k - 1];
+        if ( diff[0] != diff[1] ) {
+            out[k] = CLIP(guess[diff[0] > diff[1]] >> 1);
+        } else {
+            out[k] = CLIP((guess[0] + guess[1]) >> 2);
+        }
+    }
+}
+
+#ifdef PPG_INTERPOLATOR_X86
+
+__attribute__((target("sse4.1")))
+static inline __m128i
+loadSse41(const unsigned short *source) {
+    return _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) source));
+}
+
+__attribute__((target("sse4.1")))
+static inline void
+storeSse41(unsigned short *destination, __m128i x) {
+    _mm_storel_epi64((__m128i *) destination, _mm_packus_epi32(x, x));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i
+clipSse41(__m128i x) {
+    return _mm_max_epi32(_mm_min_epi32(x, _mm_set1_epi32(65535)), _mm_setzero_si128());
+}
+
+__attribute__((target("sse4.1")))
+static int
+greenSse41(const unsigned short *mosaic[7][2], int parity, int first, int last, unsigned short *green) {
+    const unsigned short *same = mosaic[3][parity];
+    const unsigned short *other = mosaic[3][!parity] + parity;
+    __m128i c0;
+    __m128i left;
+    __m128i right;
+    __m128i up;
+    __m128i down;
+    __m128i guess[2];
+    __m128i diff[2];
+    __m128i vertical;
+    int k;
+
+    for ( k = first; k + 4 <= last; k += 4 ) {
+        c0 = loadSse41(same + k);
+        left = loadSse41(other + k - 1);
+        right = loadSse41(other + k);
+        guess[0] = _mm_sub_epi32(_mm_sub_epi32(_mm_slli_epi32(_mm_add_epi32(_mm_add_epi32(left, c0), right), 1),
+                                               loadSse41(same + k - 1)), loadSse41(same + k + 1));
+        diff[0] = _mm_add_epi32(_mm_add_epi32(_mm_abs_epi32(_mm_sub_epi32(loadSse41(same + k - 1), c0)),
+                                              _mm_abs_epi32(_mm_sub_epi32(loadSse41(same + k + 1), c0))),
+                                _mm_abs_epi32(_mm_sub_epi32(left, right)));
+        diff[0] = _mm_add_epi32(_mm_add_epi32(diff[0], _mm_slli_epi32(diff[0], 1)), _mm_slli_epi32(_mm_add_epi32(
+            _mm_abs_epi32(_mm_sub_epi32(loadSse41(other + k + 1), right)),
+            _mm_abs_epi32(_mm_sub_epi32(loadSse41(other + k - 2), left))), 1));
+        up = loadSse41(mosaic[2][parity] + k);
+        down = loadSse41(mosaic[4][parity] + k);
+        guess[1] = _mm_sub_epi32(_mm_sub_epi32(_mm_slli_epi32(_mm_add_epi32(_mm_add_epi32(up, c0), down), 1),
+                                               loadSse41(mosaic[1][parity] + k)), loadSse41(mosaic[5][parity] + k));
+        diff[1] = _mm_add_epi32(_mm_add_epi32(_mm_abs_epi32(_mm_sub_epi32(loadSse41(mosaic[1][parity] + k), c0)),
+                                              _mm_abs_epi32(_mm_sub_epi32(loadSse41(mosaic[5][parity] + k), c0))),
+                                _mm_abs_epi32(_mm_sub_epi32(up, down)));
+        diff[1] = _mm_add_epi32(_mm_add_epi32(diff[1], _mm_slli_epi32(diff[1], 1)), _mm_slli_epi32(_mm_add_epi32(
+            _mm_abs_epi32(_mm_sub_epi32(loadSse41(mosaic[6][parity] + k), down)),
+            _mm_abs_epi32(_mm_sub_epi32(loadSse41(mosaic[0][parity] + k), up))), 1));
+
+        // Lanes going vertical take the vertical guess, limited by the greens above and below
+        vertical = _mm_cmpgt_epi32(diff[0], diff[1]);
+        guess[0] = _mm_srai_epi32(_mm_blendv_epi8(guess[0], guess[1], vertical), 2);
+        left = _mm_blendv_epi8(left, up, vertical);
+        right = _mm_blendv_epi8(right, down, vertical);
+        storeSse41(green + k, _mm_max_epi32(_mm_min_epi32(left, right),
+                                            _mm_min_epi32(guess[0], _mm_max_epi32(left, right))));
+    }
+    return k;
+}
+
+__attribute__((target("sse4.1")))
+static int
+greenSitesSse41(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *horizontal, unsigned short *vertical) {
+    const unsigned short *other = mosaic[1][!parity] + parity;
+    const unsigned short *otherGreen = green[1][!parity] + parity;
+    __m128i g0;
+    int k;
+
+    for ( k = first; k + 4 <= last; k += 4 ) {
+        g0 = _mm_slli_epi32(loadSse41(mosaic[1][parity] + k), 1);
+        storeSse41(horizontal + k, clipSse41(_mm_srai_epi32(_mm_sub_epi32(
+            _mm_add_epi32(_mm_add_epi32(loadSse41(other + k - 1), loadSse41(other + k)), g0),
+            _mm_add_epi32(loadSse41(otherGreen + k - 1), loadSse41(otherGreen + k))), 1)));
+        storeSse41(vertical + k, clipSse41(_mm_srai_epi32(_mm_sub_epi32(
+            _mm_add_epi32(_mm_add_epi32(loadSse41(mosaic[0][parity] + k), loadSse41(mosaic[2][parity] + k)), g0),
+            _mm_add_epi32(loadSse41(green[0][parity] + k), loadSse41(green[2][parity] + k))), 1)));
+    }
+    return k;
+}
+
+__attribute__((target("sse4.1")))
+static int
+diagonalSse41(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *out) {
+    const unsigned short *up = mosaic[0][!parity] + parity;
+    const unsigned short *down = mosaic[2][!parity] + parity;
+    const unsigned short *upGreen = green[0][!parity] + parity;
+    const unsigned short *downGreen = green[2][!parity] + parity;
+    __m128i g0;
+    __m128i a;
+    __m128i b;
+    __m128i ga;
+    __m128i gb;
+    __m128i guess[2];
+    __m128i diff[2];
+    int k;
+
+    for ( k = first; k + 4 <= last; k += 4 ) {
+        g0 = loadSse41(green[1][parity] + k);
+        a = loadSse41(up + k - 1);
+        b = loadSse41(down + k);
+        ga = loadSse41(upGreen + k - 1);
+        gb = loadSse41(downGreen + k);
+        diff[0] = _mm_add_epi32(_mm_add_epi32(_mm_abs_epi32(_mm_sub_epi32(a, b)), _mm_abs_epi32(_mm_sub_epi32(ga, g0))),
+                                _mm_abs_epi32(_mm_sub_epi32(gb, g0)));
+        guess[0] = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(a, b), _mm_slli_epi32(g0, 1)), _mm_add_epi32(ga, gb));
+        a = loadSse41(up + k);
+        b = loadSse41(down + k - 1);
+        ga = loadSse41(upGreen + k);
+        gb = loadSse41(downGreen + k - 1);
+        diff[1] = _mm_add_epi32(_mm_add_epi32(_mm_abs_epi32(_mm_sub_epi32(a, b)), _mm_abs_epi32(_mm_sub_epi32(ga, g0))),
+                                _mm_abs_epi32(_mm_sub_epi32(gb, g0)));
+        guess[1] = _mm_sub_epi32(_mm_add_epi32(_mm_add_epi32(a, b), _mm_slli_epi32(g0, 1)), _mm_add_epi32(ga, gb));
+        a = _mm_srai_epi32(_mm_blendv_epi8(guess[0], guess[1], _mm_cmpgt_epi32(diff[0], diff[1])), 1);
+        b = _mm_srai_epi32(_mm_add_epi32(guess[0], guess[1]), 2);
+        storeSse41(out + k, clipSse41(_mm_blendv_epi8(a, b, _mm_cmpeq_epi32(diff[0], diff[1]))));
+    }
+    return k;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+loadAvx2(const unsigned short *source) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) source));
+}
+
+__attribute__((target("avx2")))
+static inline void
+storeAvx2(unsigned short *destination, __m256i x) {
+    _mm_storeu_si128((__m128i *) destination,
+                     _mm_packus_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+clipAvx2(__m256i x) {
+    return _mm256_max_epi32(_mm256_min_epi32(x, _mm256_set1_epi32(65535)), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2")))
+static int
+greenAvx2(const unsigned short *mosaic[7][2], int parity, int first, int last, unsigned short *green) {
+    const unsigned short *same = mosaic[3][parity];
+    const unsigned short *other = mosaic[3][!parity] + parity;
+    __m256i c0;
+    __m256i left;
+    __m256i right;
+    __m256i up;
+    __m256i down;
+    __m256i guess[2];
+    __m256i diff[2];
+    __m256i vertical;
+    int k;
+
+    for ( k = first; k + 8 <= last; k += 8 ) {
+        c0 = loadAvx2(same + k);
+        left = loadAvx2(other + k - 1);
+        right = loadAvx2(other + k);
+        guess[0] = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_slli_epi32(_mm256_add_epi32(_mm256_add_epi32(left, c0), right), 1),
+                                                     loadAvx2(same + k - 1)), loadAvx2(same + k + 1));
+        diff[0] = _mm256_add_epi32(_mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(loadAvx2(same + k - 1), c0)),
+                                                    _mm256_abs_epi32(_mm256_sub_epi32(loadAvx2(same + k + 1), c0))),
+                                   _mm256_abs_epi32(_mm256_sub_epi32(left, right)));
+        diff[0] = _mm256_add_epi32(_mm256_add_epi32(diff[0], _mm256_slli_epi32(diff[0], 1)), _mm256_slli_epi32(_mm256_add_epi32(
+            _mm256_abs_epi32(_mm256_sub_epi32(loadAvx2(other + k + 1), right)),
+            _mm256_abs_epi32(_mm256_sub_epi32(loadAvx2(other + k - 2), left))), 1));
+        up = loadAvx2(mosaic[2][parity] + k);
+        down = loadAvx2(mosaic[4][parity] + k);
+        guess[1] = _mm256_sub_epi32(_mm256_sub_epi32(_mm256_slli_epi32(_mm256_add_epi32(_mm256_add_epi32(up, c0), down), 1),
+                                                     loadAvx2(mosaic[1][parity] + k)), loadAvx2(mosaic[5][parity] + k));
+        diff[1] = _mm256_add_epi32(_mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(loadAvx2(mosaic[1][parity] + k), c0)),
+                                                    _mm256_abs_epi32(_mm256_sub_epi32(loadAvx2(mosaic[5][parity] + k), c0))),
+                                   _mm256_abs_epi32(_mm256_sub_epi32(up, down)));
+        diff[1] = _mm256_add_epi32(_mm256_add_epi32(diff[1], _mm256_slli_epi32(diff[1], 1)), _mm256_slli_epi32(_mm256_add_epi32(
+            _mm256_abs_epi32(_mm256_sub_epi32(loadAvx2(mosaic[6][parity] + k), down)),
+            _mm256_abs_epi32(_mm256_sub_epi32(loadAvx2(mosaic[0][parity] + k), up))), 1));
+
+        vertical = _mm256_cmpgt_epi32(diff[0], diff[1]);
+        guess[0] = _mm256_srai_epi32(_mm256_blendv_epi8(guess[0], guess[1], vertical), 2);
+        left = _mm256_blendv_epi8(left, up, vertical);
+        right = _mm256_blendv_epi8(right, down, vertical);
+        storeAvx2(green + k, _mm256_max_epi32(_mm256_min_epi32(left, right),
+                                              _mm256_min_epi32(guess[0], _mm256_max_epi32(left, right))));
+    }
+    return k;
+}
+
+__attribute__((target("avx2")))
+static int
+greenSitesAvx2(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *horizontal, unsigned short *vertical) {
+    const unsigned short *other = mosaic[1][!parity] + parity;
+    const unsigned short *otherGreen = green[1][!parity] + parity;
+    __m256i g0;
+    int k;
+
+    for ( k = first; k + 8 <= last; k += 8 ) {
+        g0 = _mm256_slli_epi32(loadAvx2(mosaic[1][parity] + k), 1);
+        storeAvx2(horizontal + k, clipAvx2(_mm256_srai_epi32(_mm256_sub_epi32(
+            _mm256_add_epi32(_mm256_add_epi32(loadAvx2(other + k - 1), loadAvx2(other + k)), g0),
+            _mm256_add_epi32(loadAvx2(otherGreen + k - 1), loadAvx2(otherGreen + k))), 1)));
+        storeAvx2(vertical + k, clipAvx2(_mm256_srai_epi32(_mm256_sub_epi32(
+            _mm256_add_epi32(_mm256_add_epi32(loadAvx2(mosaic[0][parity] + k), loadAvx2(mosaic[2][parity] + k)), g0),
+            _mm256_add_epi32(loadAvx2(green[0][parity] + k), loadAvx2(green[2][parity] + k))), 1)));
+    }
+    return k;
+}
+
+__attribute__((target("avx2")))
+static int
+diagonalAvx2(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *out) {
+    const unsigned short *up = mosaic[0][!parity] + parity;
+    const unsigned short *down = mosaic[2][!parity] + parity;
+    const unsigned short *upGreen = green[0][!parity] + parity;
+    const unsigned short *downGreen = green[2][!parity] + parity;
+    __m256i g0;
+    __m256i a;
+    __m256i b;
+    __m256i ga;
+    __m256i gb;
+    __m256i guess[2];
+    __m256i diff[2];
+    int k;
+
+    for ( k = first; k + 8 <= last; k += 8 ) {
+        g0 = loadAvx2(green[1][parity] + k);
+        a = loadAvx2(up + k - 1);
+        b = loadAvx2(down + k);
+        ga = loadAvx2(upGreen + k - 1);
+        gb = loadAvx2(downGreen + k);
+        diff[0] = _mm256_add_epi32(_mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(a, b)),
+                                                    _mm256_abs_epi32(_mm256_sub_epi32(ga, g0))),
+                                   _mm256_abs_epi32(_mm256_sub_epi32(gb, g0)));
+        guess[0] = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(a, b), _mm256_slli_epi32(g0, 1)), _mm256_add_epi32(ga, gb));
+        a = loadAvx2(up + k);
+        b = loadAvx2(down + k - 1);
+        ga = loadAvx2(upGreen + k);
+        gb = loadAvx2(downGreen + k - 1);
+        diff[1] = _mm256_add_epi32(_mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(a, b)),
+                                                    _mm256_abs_epi32(_mm256_sub_epi32(ga, g0))),
+                                   _mm256_abs_epi32(_mm256_sub_epi32(gb, g0)));
+        guess[1] = _mm256_sub_epi32(_mm256_add_epi32(_mm256_add_epi32(a, b), _mm256_slli_epi32(g0, 1)), _mm256_add_epi32(ga, gb));
+        a = _mm256_srai_epi32(_mm256_blendv_epi8(guess[0], guess[1], _mm256_cmpgt_epi32(diff[0], diff[1])), 1);
+        b = _mm256_srai_epi32(_mm256_add_epi32(guess[0], guess[1]), 2);
+        storeAvx2(out + k, clipAvx2(_mm256_blendv_epi8(a, b, _mm256_cmpeq_epi32(diff[0], diff[1]))));
+    }
+    return k;
+}
+
+#endif
+
+static struct PpgKernels
+selectKernels() {
+    struct PpgKernels kernels = {nullptr, nullptr, nullptr};
+
+#ifdef PPG_INTERPOLATOR_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        kernels.green = greenAvx2;
+        kernels.greenSites = greenSitesAvx2;
+        kernels.diagonal = diagonalAvx2;
+    } else if ( cpuFeatures() & CPU_SSE41 ) {
+        kernels.green = greenSse41;
+        kernels.greenSites = greenSitesSse41;
+        kernels.diagonal = diagonalSse41;
+    }
+#endif
+    return kernels;
+}
+
+static const struct PpgKernels &
+kernels() {
+    static const struct PpgKernels selected = selectKernels();
+
+    return selected;
+}
+
+void
+ppgGreenRow(const unsigned short *mosaic[7][2], int parity, int first, int last, unsigned short *green) {
+    if ( kernels().green ) {
+        first = kernels().green(mosaic, parity, first, last, green);
+    }
+    greenScalar(mosaic, parity, first, last, green);
+}
+
+void
+ppgGreenSitesRow(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *horizontal, unsigned short *vertical) {
+    if ( kernels().greenSites ) {
+        first = kernels().greenSites(mosaic, green, parity, first, last, horizontal, vertical);
+    }
+    greenSitesScalar(mosaic, green, parity, first, last, horizontal, vertical);
+}
+
+void
+ppgDiagonalRow(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *out) {
+    if ( kernels().diagonal ) {
+        first = kernels().diagonal(mosaic, green, parity, first, last, out);
+    }
+    diagonalScalar(mosaic, green, parity, first, last, out);
+}
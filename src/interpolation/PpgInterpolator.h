@@ -3,5 +3,30 @@
 
 #include "Interpolator.h"
 
+/**
+ * Row kernels of ppg_interpolate() for Bayer patterns. They work on rows split by column parity: row[p][k]
+ * is the pixel in column 2 * k + p. mosaic rows hold the raw value of each pixel, green rows its green,
+ * raw or interpolated. The sites of a row are the pixels of parity `parity`, k from first to last - 1, and
+ * their neighbours up to three columns away have to be in the rows.
+ *
+ * Sites are done eight or four at a time with AVX2 or SSE4.1 when the processor has them.
+ */
+
+/**
+ * Green at the red and blue sites of the middle row of mosaic[7], rows row - 3 to row + 3
+ */
+extern void ppgGreenRow(const unsigned short *mosaic[7][2], int parity, int first, int last, unsigned short *green);
+
+/**
+ * Red and blue at the green sites of the middle row of mosaic[3] and green[3], rows row - 1 to row + 1:
+ * horizontal gets the color of the pixels to the left and right, vertical the other one
+ */
+extern void ppgGreenSitesRow(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *horizontal, unsigned short *vertical);
+
+/**
+ * Blue at the red sites and red at the blue sites of the middle row of mosaic[3] and green[3], from the
+ * diagonal neighbours
+ */
+extern void ppgDiagonalRow(const unsigned short *mosaic[3][2], const unsigned short *green[3][2], int parity, int first, int last, unsigned short *out);
 
 #endif
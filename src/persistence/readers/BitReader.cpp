@@ -0,0 +1,145 @@
+#include "BitReader.h"
+
+/*
+Discards the buffered bits and starts reading from the current input position, same as getbits(-1).
+GLOBAL_IO_zeroAfterFf is taken at this point.
+*/
+void
+BitReader::restart() {
+    bitbuf = 0;
+    vbits = 0;
+    reset = 0;
+    errors = 0;
+    zeroAfterFf = GLOBAL_IO_zeroAfterFf;
+    attached = 1;
+    if ( inputInMemory() ) {
+        data = GLOBAL_IO_input.data;
+        end = data + GLOBAL_IO_input.size;
+        cursor = GLOBAL_IO_input.position < GLOBAL_IO_input.size ? data + GLOBAL_IO_input.position : end;
+    } else {
+        data = cursor = end = nullptr;
+    }
+}
+
+/*
+Starts reading the bytes in [begin, end), removing the zero after each 0xFF if zeroAfterFf is set
+*/
+void
+BitReader::restart(const unsigned char *begin, const unsigned char *end, int zeroAfterFf) {
+    bitbuf = 0;
+    vbits = 0;
+    reset = 0;
+    errors = 0;
+    attached = 0;
+    this->zeroAfterFf = zeroAfterFf;
+    this->end = end;
+    data = cursor = begin;
+}
+
+/*
+Skips to the byte following the next restart marker (0xFFD0 to 0xFFDF), looking for it from two bytes
+before the first byte not read yet, and restarts there: on the input, or on the rest of the range.
+*/
+void
+BitReader::restartAfterMarker() {
+    unsigned short mark = 0;
+    unsigned saved;
+    int c;
+
+    if ( attached ) {
+        sync();
+        inputSeek(-2, SEEK_CUR);
+        do mark = (mark << 8) + (c = inputGetc());
+        while ( c != EOF && mark >> 4 != 0xffd );
+        restart();
+        return;
+    }
+    saved = errors;
+    cursor = cursor - data >= 2 ? cursor - 2 : data;
+    do mark = (mark << 8) + (c = cursor < end ? *cursor++ : EOF);
+    while ( c != EOF && mark >> 4 != 0xffd );
+    restart(cursor, end, zeroAfterFf);
+    errors = saved;
+}
+
+/*
+Moves the input position to the first byte not read yet by this reader
+*/
+void
+BitReader::sync() {
+    if ( attached && end ) {
+        GLOBAL_IO_input.position = cursor - data;
+    }
+}
+
+/*
+Reports corrupt data at the current position, or only counts it when reading a range
+*/
+void
+BitReader::error() {
+    if ( !attached ) {
+        errors++;
+        return;
+    }
+    sync();
+    inputOutputError();
+}
+
+/*
+Refills the accumulator one byte at a time, removing the zero after each 0xFF and stopping at markers.
+Used near the end of the input and around 0xFF bytes. When the input is not in memory only the bytes
+needed for nbits are read, so the file position stays where getbits() would leave it.
+*/
+void
+BitReader::fillBytes(int nbits) {
+    int c;
+
+    while ( vbits >= 0 && vbits <= 56 && !reset && (end || vbits < nbits) ) {
+        if ( end ) {
+            if ( cursor >= end ) {
+                break;
+            }
+            c = *cursor++;
+        } else {
+            if ( (c = inputGetc()) == EOF ) {
+                break;
+            }
+        }
+        if ( zeroAfterFf && c == 0xff ) {
+            if ( end ) {
+                reset = cursor >= end || *cursor++;
+            } else {
+                reset = inputGetc() != 0;
+            }
+            if ( reset ) {
+                break;
+            }
+        }
+        bitbuf |= (unsigned long long) c << (56 - vbits);
+        vbits += 8;
+    }
+}
+
+/*
+Gives out the bits left when the input ended before nbits could be read: zero bits complete them.
+*/
+unsigned
+BitReader::underflow(int nbits, const unsigned short *huff) {
+    unsigned c;
+    int length = nbits;
+
+    if ( vbits < 0 ) {
+        return 0;
+    }
+    c = (unsigned) (bitbuf >> 1 >> (63 - nbits));
+    if ( huff ) {
+        length = huff[c] >> 8;
+        c = (unsigned char) huff[c];
+    }
+    bitbuf <<= length;
+    vbits -= length;
+    if ( vbits < 0 ) {
+        error();
+    }
+    return c;
+}
@@ -0,0 +1,138 @@
+#ifndef __BIT_READER__
+#define __BIT_READER__
+
+#include "../../common/util.h"
+#include "globalsio.h"
+
+/**
+ * Reads the input as a big endian bit stream, the same way getbits() / gethuff() do, but keeping its
+ * state in the object instead of in hidden statics, so a loader can keep it as a local variable.
+ *
+ * Bits are kept in a 64-bit accumulator that is refilled 4 to 7 bytes at a time when the input is in
+ * memory. JPEG 0xFF stuffing (GLOBAL_IO_zeroAfterFf) is only handled byte by byte for the refills that
+ * contain a 0xFF. Reading stops at the first marker (0xFF followed by a non zero byte) or at the end of
+ * the input; from there on zero bits are returned and reading past the available bits is reported as
+ * an input error.
+ *
+ * When the input is in memory the reader reads ahead of the bits given out, through its own cursor: the
+ * input position is only updated by sync(). Otherwise it reads byte by byte, only what is needed.
+ * restart() has to be called before the first read, as getbits(-1) is.
+ *
+ * A reader restarted on a range of bytes instead of on the input does not use any decoding state, so
+ * it can run on a helper thread: errors are counted in errors instead of reported.
+ */
+class BitReader {
+  private:
+    const unsigned char *data;
+    const unsigned char *cursor;
+    const unsigned char *end;
+    unsigned long long bitbuf; // Valid bits are the vbits most significant ones
+    int vbits;
+    int reset;
+    int zeroAfterFf;
+    int attached; // Reading the input, not a range
+
+    void fillBytes(int nbits);
+    unsigned underflow(int nbits, const unsigned short *huff);
+
+    inline void
+    fill(int nbits) {
+        unsigned long long word;
+        int bytes;
+
+        if ( end - cursor >= 8 && vbits >= 0 && !reset ) {
+            bytes = (63 - vbits) >> 3;
+            word = (unsigned long long) cursor[0] << 56 | (unsigned long long) cursor[1] << 48 |
+                   (unsigned long long) cursor[2] << 40 | (unsigned long long) cursor[3] << 32 |
+                   (unsigned long long) cursor[4] << 24 | (unsigned long long) cursor[5] << 16 |
+                   (unsigned long long) cursor[6] << 8 | (unsigned long long) cursor[7];
+            word &= ~(~0ULL >> (bytes << 3));
+
+            // A 0xFF byte in word is a zero byte in ~word
+            if ( !zeroAfterFf || !((~word - 0x0101010101010101ULL) & word & 0x8080808080808080ULL) ) {
+                bitbuf |= word >> vbits;
+                vbits += bytes << 3;
+                cursor += bytes;
+                return;
+            }
+        }
+        fillBytes(nbits);
+    }
+
+  public:
+    unsigned errors; // Errors found since restarting on a range
+
+    void restart();
+    void restart(const unsigned char *begin, const unsigned char *end, int zeroAfterFf);
+    void restartAfterMarker();
+    void sync();
+    void error();
+
+    /**
+     * Same as getbits(nbits), for nbits in [0, 25]
+     */
+    inline unsigned
+    getBits(int nbits) {
+        unsigned c;
+
+        if ( vbits < nbits ) {
+            fill(nbits);
+            if ( vbits < nbits ) {
+                return underflow(nbits, 0);
+            }
+        }
+        c = (unsigned) (bitbuf >> 1 >> (63 - nbits));
+        bitbuf <<= nbits;
+        vbits -= nbits;
+        return c;
+    }
+
+    /**
+     * Same as gethuff(huff), for a table built by make_decoder()
+     */
+    inline unsigned
+    getHuff(const unsigned short *huff) {
+        unsigned c;
+
+        if ( vbits < huff[0] ) {
+            fill(huff[0]);
+            if ( vbits < huff[0] ) {
+                return underflow(huff[0], huff + 1);
+            }
+        }
+        c = huff[1 + (bitbuf >> 1 >> (63 - huff[0]))];
+        bitbuf <<= c >> 8;
+        vbits -= c >> 8;
+        return (unsigned char) c;
+    }
+
+    /**
+     * Reads a code and its difference bits with a single lookup in a table built by make_diff_decoder().
+     * Returns 0, without reading anything, for the codes the table does not resolve, near markers and
+     * the end of the input and when the input is not in memory: those are read with getHuff() and
+     * getBits() on table->huff.
+     */
+    inline const struct HuffDiff *
+    getHuffDiff(const struct HuffDiffTable *table) {
+        const struct HuffDiff *entry;
+
+        if ( vbits < HUFF_DIFF_BITS ) {
+            if ( !end ) {
+                return 0;
+            }
+            fill(HUFF_DIFF_BITS);
+            if ( vbits < HUFF_DIFF_BITS ) {
+                return 0;
+            }
+        }
+        entry = table->entry + (bitbuf >> (64 - HUFF_DIFF_BITS));
+        if ( !entry->length ) {
+            return 0;
+        }
+        bitbuf <<= entry->length;
+        vbits -= entry->length;
+        return entry;
+    }
+};
+
+#endif
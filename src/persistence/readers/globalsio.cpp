@@ -1,24 +1,211 @@
+#include <cstdarg>
+#include <cstring>
 #include <arpa/inet.h>
 #include <unistd.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "../../common/globals.h"
 #include "globalsio.h"
 #include "../../common/CameraImageInformation.h"
 
-FILE *GLOBAL_IO_ifp;
-FILE *ofp;
-unsigned GLOBAL_IO_dataError;
-unsigned GLOBAL_IO_zeroAfterFf;
-off_t GLOBAL_IO_profileOffset;
+thread_local FILE *GLOBAL_IO_ifp;
+thread_local FILE *ofp;
+thread_local unsigned GLOBAL_IO_dataError;
+thread_local unsigned GLOBAL_IO_zeroAfterFf;
+thread_local off_t GLOBAL_IO_profileOffset;
+thread_local struct InputSource GLOBAL_IO_input;
+
+/*
+Maps the whole file in memory for the input* functions. Files that can not be mapped (pipes, empty
+files) are left to stdio.
+*/
+void
+inputMap(FILE *file) {
+    inputRelease();
+    GLOBAL_IO_input.file = file;
+#ifndef WIN32
+    struct stat status;
+    void *data;
+
+    if ( !file || fstat(fileno(file), &status) || !S_ISREG(status.st_mode) || status.st_size <= 0 ) {
+        return;
+    }
+    data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if ( data == MAP_FAILED ) {
+        return;
+    }
+    GLOBAL_IO_input.data = (const unsigned char *) data;
+    GLOBAL_IO_input.size = status.st_size;
+    GLOBAL_IO_input.mapped = 1;
+#endif
+}
+
+/*
+Reads file from buffer, which holds all of its contents and has to outlive the decoding.
+*/
+void
+inputAttach(FILE *file, const void *buffer, size_t length) {
+    inputRelease();
+    GLOBAL_IO_input.file = file;
+    GLOBAL_IO_input.data = (const unsigned char *) buffer;
+    GLOBAL_IO_input.size = length;
+}
+
+void
+inputRelease() {
+#ifndef WIN32
+    if ( GLOBAL_IO_input.mapped ) {
+        munmap((void *) GLOBAL_IO_input.data, GLOBAL_IO_input.size);
+    }
+#endif
+    memset(&GLOBAL_IO_input, 0, sizeof GLOBAL_IO_input);
+}
+
+int
+inputGetcFile() {
+    // GLOBAL_IO_ifp is only used by the thread decoding it
+#if defined(DJGPP) || defined(__MINGW32__)
+    return fgetc(GLOBAL_IO_ifp);
+#else
+    return getc_unlocked(GLOBAL_IO_ifp);
+#endif
+}
+
+/*
+Same as fread(buffer, size, count, GLOBAL_IO_ifp)
+*/
+size_t
+inputRead(void *buffer, size_t size, size_t count) {
+    off_t available;
+    size_t bytes;
+
+    if ( !inputInMemory() ) {
+        return fread(buffer, size, count, GLOBAL_IO_ifp);
+    }
+    if ( !size || !count ) {
+        return 0;
+    }
+    available = GLOBAL_IO_input.size - GLOBAL_IO_input.position;
+    bytes = size * count;
+    if ( available < (off_t) bytes ) {
+        bytes = available > 0 ? available : 0;
+        GLOBAL_IO_input.eof = 1;
+    }
+    if ( bytes ) {
+        memcpy(buffer, GLOBAL_IO_input.data + GLOBAL_IO_input.position, bytes);
+        GLOBAL_IO_input.position += bytes;
+    }
+    return bytes / size;
+}
+
+/*
+Same as fseeko(GLOBAL_IO_ifp, offset, whence)
+*/
+int
+inputSeek(off_t offset, int whence) {
+    if ( !inputInMemory() ) {
+        return fseeko(GLOBAL_IO_ifp, offset, whence);
+    }
+    if ( whence == SEEK_CUR ) {
+        offset += GLOBAL_IO_input.position;
+    } else if ( whence == SEEK_END ) {
+        offset += GLOBAL_IO_input.size;
+    }
+    if ( offset < 0 ) {
+        return -1;
+    }
+    GLOBAL_IO_input.position = offset;
+    GLOBAL_IO_input.eof = 0;
+    return 0;
+}
+
+off_t
+inputTell() {
+    if ( !inputInMemory() ) {
+        return ftello(GLOBAL_IO_ifp);
+    }
+    return GLOBAL_IO_input.position;
+}
+
+int
+inputEof() {
+    if ( !inputInMemory() ) {
+        return feof(GLOBAL_IO_ifp);
+    }
+    return GLOBAL_IO_input.eof;
+}
+
+/*
+Same as fgets(buffer, size, GLOBAL_IO_ifp)
+*/
+char *
+inputGets(char *buffer, int size) {
+    int i;
+    int c;
+
+    if ( !inputInMemory() ) {
+        return fgets(buffer, size, GLOBAL_IO_ifp);
+    }
+    if ( size <= 0 ) {
+        return nullptr;
+    }
+    for ( i = 0; i < size - 1; ) {
+        if ( (c = inputGetc()) == EOF ) {
+            if ( !i ) {
+                return nullptr;
+            }
+            break;
+        }
+        buffer[i++] = (char) c;
+        if ( c == '\n' ) {
+            break;
+        }
+    }
+    buffer[i] = '\0';
+    return buffer;
+}
+
+/*
+Same as fscanf(GLOBAL_IO_ifp, format, ...). Only used on a few text fields, so it lets stdio do the
+parsing from the current position.
+*/
+int
+inputScanf(const char *format, ...) {
+    va_list arguments;
+    int status;
+
+    va_start(arguments, format);
+    status = vfscanf(inputFile(), format, arguments);
+    va_end(arguments);
+    if ( inputInMemory() ) {
+        GLOBAL_IO_input.position = ftello(GLOBAL_IO_ifp);
+        GLOBAL_IO_input.eof = feof(GLOBAL_IO_ifp);
+    }
+    return status;
+}
+
+/*
+Returns GLOBAL_IO_ifp positioned where the input* functions are, for code that needs a FILE
+*/
+FILE *
+inputFile() {
+    if ( inputInMemory() ) {
+        fseeko(GLOBAL_IO_ifp, GLOBAL_IO_input.position, SEEK_SET);
+    }
+    return GLOBAL_IO_ifp;
+}
 
 void
 inputOutputError() {
     if ( !GLOBAL_IO_dataError ) {
         fprintf(stderr, "%s: ", CAMERA_IMAGE_information.inputFilename);
-        if ( feof(GLOBAL_IO_ifp) ) {
+        if ( inputEof() ) {
             fprintf(stderr, "Unexpected end of file\n");
         } else {
-            fprintf(stderr, "Corrupt data near 0x%llx\n", (long long) ftello(GLOBAL_IO_ifp));
+            fprintf(stderr, "Corrupt data near 0x%llx\n", (long long) inputTell());
         }
     }
     GLOBAL_IO_dataError++;
@@ -57,14 +244,24 @@ unsignedEndianSwap(const unsigned char *s) {
 unsigned short
 read2bytes() {
     unsigned char str[2] = {0xff, 0xff};
-    fread(str, 1, 2, GLOBAL_IO_ifp);
+
+    if ( inputInMemory() && GLOBAL_IO_input.position >= 0 && GLOBAL_IO_input.position + 2 <= GLOBAL_IO_input.size ) {
+        GLOBAL_IO_input.position += 2;
+        return unsignedShortEndianSwap(GLOBAL_IO_input.data + GLOBAL_IO_input.position - 2);
+    }
+    inputRead(str, 1, 2);
     return unsignedShortEndianSwap(str);
 }
 
 unsigned
 read4bytes() {
     unsigned char str[4] = {0xff, 0xff, 0xff, 0xff};
-    fread(str, 1, 4, GLOBAL_IO_ifp);
+
+    if ( inputInMemory() && GLOBAL_IO_input.position >= 0 && GLOBAL_IO_input.position + 4 <= GLOBAL_IO_input.size ) {
+        GLOBAL_IO_input.position += 4;
+        return unsignedEndianSwap(GLOBAL_IO_input.data + GLOBAL_IO_input.position - 4);
+    }
+    inputRead(str, 1, 4);
     return unsignedEndianSwap(str);
 }
 
@@ -102,17 +299,17 @@ readDouble(int type) {
         case 12:
             rev = 7 * ((GLOBAL_endianOrder == LITTLE_ENDIAN_ORDER) == (ntohs(0x1234) == 0x1234));
             for ( i = 0; i < 8; i++ ) {
-                u.c[i ^ rev] = fgetc(GLOBAL_IO_ifp);
+                u.c[i ^ rev] = inputGetc();
             }
             return u.d;
         default:
-            return fgetc(GLOBAL_IO_ifp);
+            return inputGetc();
     }
 }
 
 void
 readShorts(unsigned short *pixel, int count) {
-    if ( fread(pixel, 2, count, GLOBAL_IO_ifp) < count ) {
+    if ( inputRead(pixel, 2, count) < count ) {
         inputOutputError();
     }
     if ( (GLOBAL_endianOrder == LITTLE_ENDIAN_ORDER) == (ntohs(0x1234) == 0x1234) ) {
@@ -122,9 +319,9 @@ readShorts(unsigned short *pixel, int count) {
 
 unsigned
 getbithuff(int nbits, const unsigned short *huff) {
-    static unsigned bitbuf = 0;
-    static int vbits = 0;
-    static int reset = 0;
+    static thread_local unsigned bitbuf = 0;
+    static thread_local int vbits = 0;
+    static thread_local int reset = 0;
     unsigned c;
 
     if ( nbits > 25 ) {
@@ -136,8 +333,8 @@ getbithuff(int nbits, const unsigned short *huff) {
     if ( nbits == 0 || vbits < 0 ) {
         return 0;
     }
-    while ( !reset && vbits < nbits && (c = fgetc(GLOBAL_IO_ifp)) != EOF &&
-            !(reset = GLOBAL_IO_zeroAfterFf && c == 0xff && fgetc(GLOBAL_IO_ifp)) ) {
+    while ( !reset && vbits < nbits && (c = inputGetc()) != EOF &&
+            !(reset = GLOBAL_IO_zeroAfterFf && c == 0xff && inputGetc()) ) {
         bitbuf = (bitbuf << 8) + (unsigned char) c;
         vbits += 8;
     }
@@ -156,8 +353,8 @@ getbithuff(int nbits, const unsigned short *huff) {
 
 unsigned
 ph1_bithuff(int nbits, unsigned short *huff) {
-    static unsigned long long bitbuf = 0;
-    static int vbits = 0;
+    static thread_local unsigned long long bitbuf = 0;
+    static thread_local int vbits = 0;
     unsigned c;
 
     if ( nbits == -1 ) {
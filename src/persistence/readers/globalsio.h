@@ -10,18 +10,49 @@
 #endif
 
 #include <cstdio>
+#include <sys/types.h>
 
-extern FILE *GLOBAL_IO_ifp;
-extern FILE *ofp;
-extern unsigned GLOBAL_IO_zeroAfterFf;
-extern unsigned GLOBAL_IO_dataError;
-extern off_t GLOBAL_IO_profileOffset;
+/*
+The raw file being decoded is read through the input* functions below instead of stdio. When the file
+could be memory mapped (or was handed over in memory) they work over its bytes in data, with the same
+results as the stdio calls they replace. Otherwise, for pipes or when mapping fails, they call stdio on
+GLOBAL_IO_ifp.
+
+data only applies to file: when GLOBAL_IO_ifp is pointed to another FILE (a temporary file, an external
+JPEG) reading goes through stdio on it, and goes back to data once GLOBAL_IO_ifp is restored.
+*/
+struct InputSource {
+    FILE *file;
+    const unsigned char *data;
+    off_t size;
+    off_t position;
+    int eof;
+    int mapped; // data comes from mmap and has to be unmapped
+};
+
+extern thread_local FILE *GLOBAL_IO_ifp;
+extern thread_local struct InputSource GLOBAL_IO_input;
+extern thread_local FILE *ofp;
+extern thread_local unsigned GLOBAL_IO_zeroAfterFf;
+extern thread_local unsigned GLOBAL_IO_dataError;
+extern thread_local off_t GLOBAL_IO_profileOffset;
 
 #define getbits(n) getbithuff((n), 0)
 #define gethuff(h) getbithuff(*(h), (h) + 1)
 #define ph1_bits(n) ph1_bithuff(n,0)
 #define ph1_huff(h) ph1_bithuff(*h,h+1)
 
+extern void inputMap(FILE *file);
+extern void inputAttach(FILE *file, const void *buffer, size_t length);
+extern void inputRelease();
+extern int inputGetcFile();
+extern size_t inputRead(void *buffer, size_t size, size_t count);
+extern int inputSeek(off_t offset, int whence);
+extern off_t inputTell();
+extern int inputEof();
+extern char *inputGets(char *buffer, int size);
+extern int inputScanf(const char *format, ...);
+extern FILE *inputFile();
 extern void inputOutputError();
 extern unsigned short unsignedShortEndianSwap(const unsigned char *s);
 extern unsigned unsignedEndianSwap(const unsigned char *s);
@@ -34,4 +65,24 @@ extern float intToFloat(int i);
 extern unsigned getbithuff(int nbits, const unsigned short *huff);
 extern unsigned ph1_bithuff(int nbits, unsigned short *huff);
 
+inline int
+inputInMemory() {
+    return GLOBAL_IO_input.data && GLOBAL_IO_ifp == GLOBAL_IO_input.file;
+}
+
+/*
+Same as fgetc(GLOBAL_IO_ifp)
+*/
+inline int
+inputGetc() {
+    if ( !inputInMemory() ) {
+        return inputGetcFile();
+    }
+    if ( GLOBAL_IO_input.position < GLOBAL_IO_input.size ) {
+        return GLOBAL_IO_input.data[GLOBAL_IO_input.position++];
+    }
+    GLOBAL_IO_input.eof = 1;
+    return EOF;
+}
+
 #endif
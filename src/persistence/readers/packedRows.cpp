@@ -0,0 +1,152 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PACKED_ROWS_X86
+#include <immintrin.h>
+#endif
+
+#include "../../common/cpuFeatures.h"
+#include "packedRows.h"
+
+// Unpacks a prefix of the row, returns the number of samples unpacked
+typedef int (*PackedRowKernel)(const unsigned char *source, long bytes, unsigned short *destination, int count, int bits, int swap);
+
+/*
+Unpacks samples first to count - 1 one at a time. Each sample is taken from the three bytes it starts in,
+swap being the xor that turns a stream position into the position of its byte inside the little endian words.
+*/
+static void
+unpackScalar(const unsigned char *source, long bytes, unsigned short *destination, int first, int count, int bits, int swap) {
+    long bit;
+    long byte;
+    unsigned window;
+    int i;
+    int j;
+
+    for ( i = first; i < count; i++ ) {
+        bit = (long) i * bits;
+        byte = bit >> 3;
+        if ( ((byte + 2) | swap) < bytes ) {
+            window = source[byte ^ swap] << 16 | source[(byte + 1) ^ swap] << 8 | source[(byte + 2) ^ swap];
+        } else {
+            for ( window = j = 0; j < 3; j++ ) {
+                window <<= 8;
+                if ( ((byte + j) ^ swap) < bytes ) {
+                    window |= source[(byte + j) ^ swap];
+                }
+            }
+        }
+        destination[i] = window >> (24 - (bit & 7) - bits) & ((1 << bits) - 1);
+    }
+}
+
+#ifdef PACKED_ROWS_X86
+
+/*
+Eight samples take bits bytes. Builds the byte shuffles that put the three bytes of each sample of such a group
+in a 32-bit lane, most significant first, and the left shifts that bring its first bit to the top of the lane.
+*/
+static void
+groupLayout(int bits, int swap, unsigned char shuffle[2][16], int shift[8]) {
+    int bit;
+    int byte;
+    int i;
+
+    for ( i = 0; i < 8; i++ ) {
+        bit = i * bits;
+        byte = bit >> 3;
+        shuffle[i >> 2][(i & 3) * 4] = (byte + 2) ^ swap;
+        shuffle[i >> 2][(i & 3) * 4 + 1] = (byte + 1) ^ swap;
+        shuffle[i >> 2][(i & 3) * 4 + 2] = byte ^ swap;
+        shuffle[i >> 2][(i & 3) * 4 + 3] = 0x80;
+        shift[i] = 8 + (bit & 7);
+    }
+}
+
+/*
+One group of eight samples per 16-byte load, the variable left shift done as a multiplication
+*/
+__attribute__((target("sse4.1")))
+static int
+unpackSse41(const unsigned char *source, long bytes, unsigned short *destination, int count, int bits, int swap) {
+    unsigned char shuffle[2][16];
+    int shift[8];
+    __m128i lowShuffle;
+    __m128i highShuffle;
+    __m128i lowScale;
+    __m128i highScale;
+    __m128i in;
+    __m128i low;
+    __m128i high;
+    int group;
+
+    groupLayout(bits, swap, shuffle, shift);
+    lowShuffle = _mm_loadu_si128((const __m128i *) shuffle[0]);
+    highShuffle = _mm_loadu_si128((const __m128i *) shuffle[1]);
+    lowScale = _mm_setr_epi32(1 << shift[0], 1 << shift[1], 1 << shift[2], 1 << shift[3]);
+    highScale = _mm_setr_epi32(1 << shift[4], 1 << shift[5], 1 << shift[6], 1 << shift[7]);
+    for ( group = 0; group * 8 + 8 <= count && (long) group * bits + 16 <= bytes; group++ ) {
+        in = _mm_loadu_si128((const __m128i *) (source + group * bits));
+        low = _mm_srli_epi32(_mm_mullo_epi32(_mm_shuffle_epi8(in, lowShuffle), lowScale), 32 - bits);
+        high = _mm_srli_epi32(_mm_mullo_epi32(_mm_shuffle_epi8(in, highShuffle), highScale), 32 - bits);
+        _mm_storeu_si128((__m128i *) (destination + group * 8), _mm_packus_epi32(low, high));
+    }
+    return group * 8;
+}
+
+/*
+Two groups of eight samples per iteration, one in each 128-bit lane
+*/
+__attribute__((target("avx2")))
+static int
+unpackAvx2(const unsigned char *source, long bytes, unsigned short *destination, int count, int bits, int swap) {
+    unsigned char shuffle[2][16];
+    int shift[8];
+    __m256i lowShuffle;
+    __m256i highShuffle;
+    __m256i lowShift;
+    __m256i highShift;
+    __m256i in;
+    __m256i low;
+    __m256i high;
+    int group;
+
+    groupLayout(bits, swap, shuffle, shift);
+    lowShuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) shuffle[0]));
+    highShuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) shuffle[1]));
+    lowShift = _mm256_setr_epi32(shift[0], shift[1], shift[2], shift[3], shift[0], shift[1], shift[2], shift[3]);
+    highShift = _mm256_setr_epi32(shift[4], shift[5], shift[6], shift[7], shift[4], shift[5], shift[6], shift[7]);
+    for ( group = 0; group * 8 + 16 <= count && (long) (group + 1) * bits + 16 <= bytes; group += 2 ) {
+        in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (source + group * bits))),
+            _mm_loadu_si128((const __m128i *) (source + (group + 1) * bits)), 1);
+        low = _mm256_srli_epi32(_mm256_sllv_epi32(_mm256_shuffle_epi8(in, lowShuffle), lowShift), 32 - bits);
+        high = _mm256_srli_epi32(_mm256_sllv_epi32(_mm256_shuffle_epi8(in, highShuffle), highShift), 32 - bits);
+        _mm256_storeu_si256((__m256i *) (destination + group * 8), _mm256_packus_epi32(low, high));
+    }
+    return group * 8;
+}
+
+#endif
+
+static PackedRowKernel
+selectKernel() {
+#ifdef PACKED_ROWS_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        return unpackAvx2;
+    }
+    if ( cpuFeatures() & CPU_SSE41 ) {
+        return unpackSse41;
+    }
+#endif
+    return nullptr;
+}
+
+void
+unpackPackedRow(const unsigned char *source, long bytes, unsigned short *destination, int count, int bits, int wordBytes) {
+    static const PackedRowKernel kernel = selectKernel();
+    int done = 0;
+
+    if ( kernel && wordBytes <= 2 && (bits == 10 || bits == 12 || bits == 14) ) {
+        done = kernel(source, bytes, destination, count, bits, wordBytes - 1);
+    }
+    unpackScalar(source, bytes, destination, done, count, bits, wordBytes - 1);
+}
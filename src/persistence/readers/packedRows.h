@@ -0,0 +1,15 @@
+#ifndef __PACKED_ROWS__
+#define __PACKED_ROWS__
+
+/**
+ * Unpacks count samples of bits bits (1 to 16) from a row of packed data, as packed_load_raw() reads
+ * them: a big endian bit stream made of words of wordBytes bytes (1 or 2, packed_load_raw() only calls
+ * it for those) stored little endian. The row must start at a word boundary. Only the first bytes bytes
+ * of source are read, missing bits are read as zeros.
+ *
+ * 10, 12 and 14 bit samples are unpacked eight or sixteen at a time with SSE4.1 or AVX2 when the
+ * processor has them, the rest one sample at a time.
+ */
+extern void unpackPackedRow(const unsigned char *source, long bytes, unsigned short *destination, int count, int bits, int wordBytes);
+
+#endif
@@ -7,6 +7,7 @@
 #include "../../../colorRepresentation/adobeCoeff.h"
 #include "../../../postprocessors/gamma.h"
 #include "../globalsio.h"
+#include "../BitReader.h"
 #include "jpegRawLoaders.h"
 #include "canonRawLoaders.h"
 
@@ -22,8 +23,8 @@ canonHasLowBits() {
     int ret = 1;
     int i;
 
-    fseek(GLOBAL_IO_ifp, 0, SEEK_SET);
-    fread(test, 1, sizeof test, GLOBAL_IO_ifp);
+    inputSeek(0, SEEK_SET);
+    inputRead(test, 1, sizeof test);
     for ( i = 540; i < sizeof test - 1; i++ ) {
         if ( test[i] == 0xff ) {
             if ( test[i + 1] ) {
@@ -235,7 +236,7 @@ canon_600_load_raw() {
     int row;
 
     for ( irow = row = 0; irow < THE_image.height; irow++ ) {
-        if ( fread(data, 1, 1120, GLOBAL_IO_ifp) < 1120 ) inputOutputError();
+        if ( inputRead(data, 1, 1120) < 1120 ) inputOutputError();
         pix = THE_image.rawData + row * THE_image.width;
         for ( dp = data; dp < data + 1120; dp += 10, pix += 8 ) {
             pix[0] = (dp[0] << 2) + (dp[1] >> 6);
@@ -284,8 +285,8 @@ canon_s2is() {
     unsigned row;
 
     for ( row = 0; row < 100; row++ ) {
-        fseek(GLOBAL_IO_ifp, row * 3340 + 3284, SEEK_SET);
-        if ( getc(GLOBAL_IO_ifp) > 15 ) {
+        inputSeek(row * 3340 + 3284, SEEK_SET);
+        if ( inputGetc() > 15 ) {
             return 1;
         }
     }
@@ -294,9 +295,12 @@ canon_s2is() {
 
 void
 canon_load_raw() {
+    BitReader bits;
     unsigned short *pixel;
     unsigned short *prow;
     unsigned short *huff[2];
+    struct HuffDiffTable *table[2];
+    const struct HuffDiff *entry;
     int nblocks;
     int lowbits;
     int i;
@@ -315,18 +319,22 @@ canon_load_raw() {
     int base[2];
 
     crw_init_tables(tiff_compress, huff);
+    for ( c = 0; c < 2; c++ ) {
+        table[c] = make_diff_decoder(huff[c], HUFF_DIFF_CANON);
+    }
     lowbits = canonHasLowBits();
     if ( !lowbits ) ADOBE_maximum = 0x3ff;
-    fseek(GLOBAL_IO_ifp, 540 + lowbits * THE_image.height * THE_image.width / 4, SEEK_SET);
+    inputSeek(540 + lowbits * THE_image.height * THE_image.width / 4, SEEK_SET);
     GLOBAL_IO_zeroAfterFf = 1;
-    getbits(-1);
+    bits.restart();
     for ( row = 0; row < THE_image.height; row += 8 ) {
         pixel = THE_image.rawData + row * THE_image.width;
         nblocks = MIN(8, THE_image.height - row) * THE_image.width >> 6;
         for ( block = 0; block < nblocks; block++ ) {
             memset(diffbuf, 0, sizeof diffbuf);
             for ( i = 0; i < 64; i++ ) {
-                leaf = gethuff(huff[i > 0]);
+                entry = bits.getHuffDiff(table[i > 0]);
+                leaf = entry ? entry->leaf : bits.getHuff(huff[i > 0]);
                 if ( leaf == 0 && i ) {
                     break;
                 }
@@ -338,9 +346,13 @@ canon_load_raw() {
                 if ( len == 0 ) {
                     continue;
                 }
-                diff = getbits(len);
-                if ( (diff & (1 << (len - 1))) == 0 ) {
-                    diff -= (1 << len) - 1;
+                if ( entry ) {
+                    diff = entry->diff;
+                } else {
+                    diff = bits.getBits(len);
+                    if ( (diff & (1 << (len - 1))) == 0 ) {
+                        diff -= (1 << len) - 1;
+                    }
                 }
                 if ( i < 64 ) {
                     diffbuf[i] = diff;
@@ -358,10 +370,10 @@ canon_load_raw() {
             }
         }
         if ( lowbits ) {
-            save = ftell(GLOBAL_IO_ifp);
-            fseek(GLOBAL_IO_ifp, 26 + row * THE_image.width / 4, SEEK_SET);
+            save = inputTell();
+            inputSeek(26 + row * THE_image.width / 4, SEEK_SET);
             for ( prow = pixel, i = 0; i < THE_image.width * 2; i++ ) {
-                c = fgetc(GLOBAL_IO_ifp);
+                c = inputGetc();
                 for ( r = 0; r < 8; r += 2, prow++ ) {
                     val = (*prow << 2) + ((c >> r) & 3);
                     if ( THE_image.width == 2672 && val < 512 ) {
@@ -370,10 +382,11 @@ canon_load_raw() {
                     *prow = val;
                 }
             }
-            fseek(GLOBAL_IO_ifp, save, SEEK_SET);
+            inputSeek(save, SEEK_SET);
         }
     }
     for ( c = 0; c < 2; c++ ) {
+        free(table[c]);
         free(huff[c]);
     }
 }
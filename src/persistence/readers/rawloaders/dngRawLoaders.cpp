@@ -1,5 +1,8 @@
 #include <climits>
+#include <vector>
 #include "../../../common/globals.h"
+#include "../../../common/Options.h"
+#include "../../../common/ThreadPool.h"
 #include "../../../imageHandling/BayessianImage.h"
 #include "../../../common/mathMacros.h"
 #include "../../../common/util.h"
@@ -32,6 +35,134 @@ packed_dng_load_raw() {
     free(pixel);
 }
 
+/*
+Samples of a row of the stream of jh as lossless_dng_load_raw() copies them, for IMAGE_filters and
+samples = MIN(is_raw, tiff_samples)
+*/
+static unsigned
+lossless_dng_row_samples(const struct jhead *jh, unsigned filters, unsigned samples) {
+    unsigned jwide = jh->wide;
+
+    if ( filters ) {
+        jwide *= jh->clrs;
+    }
+    return jwide / samples;
+}
+
+/*
+Decodes the lossless stream of jh to the tile of target at trow, tcol, rowWidth samples wide
+*/
+static void
+lossless_dng_copy_tile(const struct AdobeCopyTarget *target, struct jhead *jh, unsigned trow, unsigned tcol,
+                       unsigned jwide, unsigned rowWidth) {
+    unsigned short *rp;
+    unsigned jrow;
+    unsigned jcol;
+    unsigned row = 0;
+    unsigned col = 0;
+
+    for ( jrow = 0; jrow < (unsigned) jh->high; jrow++ ) {
+        rp = ljpeg_row(jrow, jh);
+        for ( jcol = 0; jcol < jwide; jcol++ ) {
+            adobe_copy_pixel(target, trow + row, tcol + col, &rp);
+            if ( ++col >= rowWidth ) {
+                row += 1 + (col = 0);
+            }
+        }
+    }
+}
+
+/*
+Parallel path of lossless_dng_load_raw() for tiled images made of lossless (0xc3) tiles: the frames of
+the tiles are checked first, then each tile is decoded on a ThreadPool by a job reading its header and
+tables into the jhead of its worker, with a BitReader on the input bytes, and copied to its own region of
+the image. Tiles with corrupt data are decoded again in order through the input, which reports it where
+it is read. Returns 0, with the input position unchanged, when the image has to be decoded tile by tile
+instead: input not in memory, a single worker, other kinds of tiles, truncated headers or tiles holding
+more samples than their region.
+*/
+static int
+lossless_dng_load_tiles() {
+    ThreadPool pool(OPTIONS_values->threads);
+    struct AdobeCopyTarget target;
+    struct jhead jh;
+    const unsigned char *data = GLOBAL_IO_input.data;
+    const unsigned char *end;
+    unsigned first;
+    unsigned last;
+    unsigned save;
+    unsigned across;
+    unsigned tiles;
+    unsigned t;
+    unsigned tileLength = tile_length;
+    unsigned tileWidth = tile_width;
+    unsigned rowWidth = MIN(tile_width, THE_image.width); // Samples of a tile row
+    unsigned filters = IMAGE_filters;
+    unsigned samples = MIN(is_raw, tiff_samples);
+    unsigned dngVersion = GLOBAL_dngVersion;
+    int ok = 1;
+
+    if ( tile_length >= INT_MAX || !tile_width || !inputInMemory() || pool.size() < 2 ) {
+        return 0;
+    }
+    across = (THE_image.width + tile_width - 1) / tile_width;
+    tiles = across * ((THE_image.height + tile_length - 1) / tile_length);
+    if ( tiles < 2 ) {
+        return 0;
+    }
+
+    // Frames, as read by the serial path: a tile that does not start a JPEG stream, or has no first Huffman
+    // table, ends the image
+    std::vector<unsigned> offset(tiles);
+    first = inputTell();
+    for ( t = 0; t < tiles; t++ ) {
+        save = inputTell();
+        offset[t] = read4bytes();
+        inputSeek(offset[t], SEEK_SET);
+        if ( !ljpeg_start(&jh, 1) || !(jh.tables & 1) ) {
+            break;
+        }
+        ok &= jh.algo == 0xc3 && !inputEof() &&
+              (unsigned long long) jh.high * lossless_dng_row_samples(&jh, filters, samples) <=
+              (unsigned long long) tileLength * rowWidth;
+        inputSeek(save + 4, SEEK_SET);
+    }
+    if ( !ok ) {
+        inputSeek(first, SEEK_SET);
+        return 0;
+    }
+    tiles = t;
+    last = inputTell();
+
+    adobe_copy_target(&target);
+    end = data + GLOBAL_IO_input.size;
+    std::vector<struct jhead> workers(pool.size());
+    std::vector<unsigned> errors(tiles, 0);
+    pool.run(tiles, [&](int tile, int worker) {
+        struct jhead *wh = &workers[worker];
+
+        if ( ljpeg_start(wh, data + offset[tile], end, dngVersion) ) {
+            lossless_dng_copy_tile(&target, wh, tile / across * tileLength, tile % across * tileWidth,
+                                   lossless_dng_row_samples(wh, filters, samples), rowWidth);
+            errors[tile] = wh->reader.errors;
+            ljpeg_end(wh);
+        }
+    });
+    for ( t = 0; t < tiles; t++ ) {
+        if ( !errors[t] ) {
+            continue;
+        }
+        inputSeek(offset[t], SEEK_SET);
+        if ( ljpeg_start(&jh, 0) ) {
+            lossless_dng_copy_tile(&target, &jh, t / across * tileLength, t % across * tileWidth,
+                                   lossless_dng_row_samples(&jh, filters, samples), rowWidth);
+            ljpeg_end(&jh);
+        }
+    }
+    inputSeek(last, SEEK_SET);
+    return 1;
+}
+
 void
 lossless_dng_load_raw() {
     unsigned save;
@@ -47,10 +178,13 @@ lossless_dng_load_raw() {
     struct jhead jh;
     unsigned short *rp;
 
+    if ( lossless_dng_load_tiles() ) {
+        return;
+    }
     while ( trow < THE_image.height ) {
-        save = ftell(GLOBAL_IO_ifp);
+        save = inputTell();
         if ( tile_length < INT_MAX ) {
-            fseek(GLOBAL_IO_ifp, read4bytes(), SEEK_SET);
+            inputSeek(read4bytes(), SEEK_SET);
         }
         if ( !ljpeg_start(&jh, 0)) {
             break;
@@ -63,7 +197,7 @@ lossless_dng_load_raw() {
         switch ( jh.algo ) {
             case 0xc1:
                 jh.vpred[0] = 16384;
-                getbits(-1);
+                jh.reader.restart();
                 for ( jrow = 0; jrow + 7 < jh.high; jrow += 8 ) {
                     for ( jcol = 0; jcol + 7 < jh.wide; jcol += 8 ) {
                         ljpeg_idct(&jh);
@@ -89,7 +223,7 @@ lossless_dng_load_raw() {
                     }
                 }
         }
-        fseek(GLOBAL_IO_ifp, save + 4, SEEK_SET);
+        inputSeek(save + 4, SEEK_SET);
         if ((tcol += tile_width) >= THE_image.width ) {
             trow += tile_length + (tcol = 0);
         }
@@ -1,30 +1,124 @@
 #include <climits>
 #include <cstring>
 #include <cstdlib>
+#include <vector>
 #include "jpegRawLoaders.h"
 #include "../../../common/globals.h"
 #include "../../../common/util.h"
+#include "../../../common/Options.h"
+#include "../../../common/ThreadPool.h"
 #include "../../../common/mathMacros.h"
 #include "../../../imageHandling/BayessianImage.h"
 #include "../../../postprocessors/gamma.h"
 #include "../globalsio.h"
 #include "jpegRawLoaders.h"
 
+/*
+Reads the marker segment tag of len bytes at data into jh. Returns 1 when the segment is followed by a
+byte to skip.
+*/
+static int
+ljpeg_marker(struct jhead *jh, unsigned short tag, const unsigned char *data, unsigned short len, int info_only,
+             unsigned dngVersion) {
+    unsigned short c;
+    int skip;
+    int i;
+    const unsigned char *dp;
+
+    switch ( tag ) {
+        case 0xffc3:
+            jh->sraw = ((data[7] >> 4) * (data[7] & 15) - 1) & 3;
+        case 0xffc1:
+        case 0xffc0:
+            jh->algo = tag & 0xff;
+            jh->bits = data[0];
+            jh->high = data[1] << 8 | data[2];
+            jh->wide = data[3] << 8 | data[4];
+            jh->clrs = data[5] + jh->sraw;
+            return len == 9 && !dngVersion;
+        case 0xffc4:
+            for ( dp = data; dp < data + len && !((c = *dp++) & -20); ) {
+                jh->tables |= 1 << c;
+                if ( !info_only ) {
+                    jh->free[c] = jh->huff[c] = make_decoder_ref(&dp);
+                    continue;
+                }
+                for ( skip = 16, i = 0; i < 16; i++ ) {
+                    skip += dp[i];
+                }
+                dp += skip;
+            }
+            break;
+        case 0xffda:
+            jh->psv = data[1 + data[0] * 2];
+            jh->bits -= data[3 + data[0] * 2] & 15;
+            break;
+        case 0xffdb:
+            for ( c = 0; c < 64; c++ ) {
+                jh->quant[c] = data[c * 2 + 1] << 8 | data[c * 2 + 2];
+            }
+            break;
+        case 0xffdd:
+            jh->restart = data[0] << 8 | data[1];
+    }
+    return 0;
+}
+
+/*
+Checks the frame read into jh and, unless info_only is set, builds its decoding tables and row. Returns 0
+when the stream cannot be decoded.
+*/
+static int
+ljpeg_tables(struct jhead *jh, int info_only, unsigned dngVersion) {
+    unsigned short c;
+    unsigned short i;
+    int mode;
+
+    if ( jh->bits > 16 || jh->clrs > 6 || !jh->bits || !jh->high || !jh->wide || !jh->clrs ) {
+        return 0;
+    }
+    if ( info_only ) {
+        return 1;
+    }
+    if ( !jh->huff[0] ) {
+        return 0;
+    }
+    for ( c = 0; c < 19; c++ ) {
+        if ( !jh->huff[c + 1] ) {
+            jh->huff[c + 1] = jh->huff[c];
+        }
+    }
+    if ( jh->sraw ) {
+        for ( c = 0; c < 4; c++ ) {
+            jh->huff[2 + c] = jh->huff[1];
+        }
+        for ( c = 0; c < jh->sraw; c++ ) {
+            jh->huff[1 + c] = jh->huff[0];
+        }
+    }
+    mode = dngVersion && dngVersion < 0x1010000 ? HUFF_DIFF_DNG10 : HUFF_DIFF_LJPEG;
+    for ( c = 0; c < jh->clrs; c++ ) {
+        for ( i = 0; i < c && jh->huff[i] != jh->huff[c]; i++ );
+        jh->diff[c] = i < c ? jh->diff[i] : make_diff_decoder(jh->huff[c], mode);
+    }
+    jh->row = (unsigned short *) calloc(jh->wide * jh->clrs, 4);
+    memoryError(jh->row, "ljpeg_start()");
+    return 1;
+}
+
 int
 ljpeg_start(struct jhead *jh, int info_only) {
-    unsigned short c;
     unsigned short tag;
     unsigned short len;
     unsigned char data[0x10000];
-    const unsigned char *dp;
 
     memset(jh, 0, sizeof *jh);
     jh->restart = INT_MAX;
-    if ((fgetc(GLOBAL_IO_ifp), fgetc(GLOBAL_IO_ifp)) != 0xd8 ) {
+    if ((inputGetc(), inputGetc()) != 0xd8 ) {
         return 0;
     }
     do {
-        if ( !fread(data, 2, 2, GLOBAL_IO_ifp)) {
+        if ( !inputRead(data, 2, 2)) {
             return 0;
         }
         tag = data[0] << 8 | data[1];
@@ -32,110 +126,124 @@ ljpeg_start(struct jhead *jh, int info_only) {
         if ( tag <= 0xff00 ) {
             return 0;
         }
-        fread(data, 1, len, GLOBAL_IO_ifp);
-        switch ( tag ) {
-            case 0xffc3:
-                jh->sraw = ((data[7] >> 4) * (data[7] & 15) - 1) & 3;
-            case 0xffc1:
-            case 0xffc0:
-                jh->algo = tag & 0xff;
-                jh->bits = data[0];
-                jh->high = data[1] << 8 | data[2];
-                jh->wide = data[3] << 8 | data[4];
-                jh->clrs = data[5] + jh->sraw;
-                if ( len == 9 && !GLOBAL_dngVersion ) {
-                    getc(GLOBAL_IO_ifp);
-                }
-                break;
-            case 0xffc4:
-                if ( info_only ) {
-                    break;
-                }
-                for ( dp = data; dp < data + len && !((c = *dp++) & -20); ) {
-                    jh->free[c] = jh->huff[c] = make_decoder_ref(&dp);
-                }
-                break;
-            case 0xffda:
-                jh->psv = data[1 + data[0] * 2];
-                jh->bits -= data[3 + data[0] * 2] & 15;
-                break;
-            case 0xffdb:
-                for ( c = 0; c < 64; c++ ) {
-                    jh->quant[c] = data[c * 2 + 1] << 8 | data[c * 2 + 2];
-                }
-                break;
-            case 0xffdd:
-                jh->restart = data[0] << 8 | data[1];
+        inputRead(data, 1, len);
+        if ( ljpeg_marker(jh, tag, data, len, info_only, GLOBAL_dngVersion) ) {
+            inputGetc();
         }
     }
     while ( tag != 0xffda );
 
-    if ( jh->bits > 16 || jh->clrs > 6 || !jh->bits || !jh->high || !jh->wide || !jh->clrs ) {
+    if ( !ljpeg_tables(jh, info_only, GLOBAL_dngVersion) ) {
         return 0;
     }
     if ( info_only ) {
         return 1;
     }
-    if ( !jh->huff[0] ) {
+    GLOBAL_IO_zeroAfterFf = 1;
+    jh->reader.restart();
+    return 1;
+}
+
+/*
+Same as ljpeg_start(jh, 0) for the stream at begin, in input bytes ending at end, with dngVersion standing
+for GLOBAL_dngVersion: the input is not used, so it can run on a helper thread. jh->reader is restarted on
+the bytes following the header. Returns 0 as well when the header runs past end.
+*/
+int
+ljpeg_start(struct jhead *jh, const unsigned char *begin, const unsigned char *end, unsigned dngVersion) {
+    unsigned short tag;
+    unsigned short len;
+    unsigned char data[0x10000];
+    const unsigned char *p = begin;
+
+    memset(jh, 0, sizeof *jh);
+    jh->restart = INT_MAX;
+    if ( end - p < 2 || p[1] != 0xd8 ) {
         return 0;
     }
-    for ( c = 0; c < 19; c++ ) {
-        if ( !jh->huff[c + 1] ) {
-            jh->huff[c + 1] = jh->huff[c];
+    p += 2;
+    do {
+        if ( end - p < 4 ) {
+            return 0;
         }
-    }
-    if ( jh->sraw ) {
-        for ( c = 0; c < 4; c++ ) {
-            jh->huff[2 + c] = jh->huff[1];
+        tag = p[0] << 8 | p[1];
+        len = (p[2] << 8 | p[3]) - 2;
+        if ( tag <= 0xff00 || end - p - 4 < len ) {
+            return 0;
         }
-        for ( c = 0; c < jh->sraw; c++ ) {
-            jh->huff[1 + c] = jh->huff[0];
+        memcpy(data, p + 4, len);
+        p += 4 + len;
+        if ( ljpeg_marker(jh, tag, data, len, 0, dngVersion) && p < end ) {
+            p++;
         }
     }
-    jh->row = (unsigned short *) calloc(jh->wide * jh->clrs, 4);
-    memoryError(jh->row, "ljpeg_start()");
-    return GLOBAL_IO_zeroAfterFf = 1;
+    while ( tag != 0xffda );
+
+    if ( !ljpeg_tables(jh, 0, dngVersion) ) {
+        return 0;
+    }
+    jh->reader.restart(p, end, 1);
+    return 1;
 }
 
 void
 ljpeg_end(struct jhead *jh) {
     int c;
+    int i;
 
     for ( c = 0; c < 4; c++ ) {
         if ( jh->free[c] ) {
             free(jh->free[c]);
         }
     }
+    for ( c = 0; c < 6; c++ ) {
+        for ( i = 0; i < c && jh->diff[i] != jh->diff[c]; i++ );
+        if ( i == c ) {
+            free(jh->diff[c]);
+        }
+    }
     free(jh->row);
 }
 
+/*
+Decodes row jrow, handling the restart markers. jh->reader is restarted by ljpeg_start() at the
+beginning of the stream; it may also be restarted on a range of bytes holding the stream, for a
+helper thread.
+*/
 unsigned short *
 ljpeg_row(int jrow, struct jhead *jh) {
-    int col;
     int c;
-    int diff;
-    int pred;
-    int spred = 0;
-    unsigned short mark = 0;
-    unsigned short *row[3];
 
     if ( jrow * jh->wide % jh->restart == 0 ) {
         for ( c = 0; c < 6; c++ ) {
             jh->vpred[c] = 1 << (jh->bits - 1);
         }
         if ( jrow ) {
-            fseek(GLOBAL_IO_ifp, -2, SEEK_CUR);
-            do mark = (mark << 8) + (c = fgetc(GLOBAL_IO_ifp));
-            while ( c != EOF && mark >> 4 != 0xffd );
+            jh->reader.restartAfterMarker();
         }
-        getbits(-1);
     }
+    return ljpeg_decode_row(jrow, jh);
+}
+
+/*
+Decodes row jrow from jh->reader, without looking for restart markers. Only jh is used, so it can run on
+a helper thread for a reader restarted on a range of bytes.
+*/
+unsigned short *
+ljpeg_decode_row(int jrow, struct jhead *jh) {
+    int col;
+    int c;
+    int diff;
+    int pred;
+    int spred = 0;
+    unsigned short *row[3];
+
     for ( c = 0; c < 3; c++ ) {
         row[c] = jh->row + jh->wide * jh->clrs * ((jrow + c) & 1);
     }
     for ( col = 0; col < jh->wide; col++ ) {
         for ( c = 0; c < jh->clrs; c++ ) {
-            diff = ljpeg_diff(jh->huff[c]);
+            diff = ljpeg_diff(jh->reader, jh->diff[c]);
             if ( jh->sraw && c <= jh->sraw && (col | c)) {
                 pred = spred;
             } else {
@@ -171,7 +279,7 @@ ljpeg_row(int jrow, struct jhead *jh) {
                         pred = 0;
                 }
             if ( (**row = pred + diff) >> jh->bits ) {
-                inputOutputError();
+                jh->reader.error();
             }
             if ( c <= jh->sraw ) {
                 spred = **row;
@@ -199,6 +307,117 @@ ljpeg_diff(unsigned short *huff) {
     return diff;
 }
 
+int
+ljpeg_diff(BitReader &bits, const struct HuffDiffTable *table) {
+    const struct HuffDiff *entry;
+    int len;
+    int diff;
+
+    if ( (entry = bits.getHuffDiff(table)) ) {
+        return entry->diff;
+    }
+    len = bits.getHuff(table->huff);
+    if ( len == 16 && table->mode == HUFF_DIFF_LJPEG ) {
+        return -32768;
+    }
+    diff = bits.getBits(len);
+    if ( (diff & (1 << (len - 1))) == 0 ) {
+        diff -= (1 << len) - 1;
+    }
+    return diff;
+}
+
+/*
+Decodes rows first to last - 1, a restart interval starting where the reader of jh was restarted, to rows
+*/
+static void
+ljpeg_decode_interval(struct jhead *jh, unsigned short *rows, int first, int last) {
+    int jwide = jh->wide * jh->clrs;
+    int jrow;
+    int c;
+
+    for ( c = 0; c < 6; c++ ) {
+        jh->vpred[c] = 1 << (jh->bits - 1);
+    }
+    for ( jrow = first; jrow < last; jrow++ ) {
+        memcpy(rows + (size_t) jrow * jwide, ljpeg_decode_row(jrow, jh), jwide * sizeof *rows);
+    }
+}
+
+/*
+Decodes all the rows of the stream at the current input position when its restart intervals hold whole
+rows, one restart interval per job on a ThreadPool, each job with its own copy of jh and a BitReader on
+the bytes between two restart markers. Intervals with corrupt data are decoded again in order through a
+reader on the input, which reports it where it is read. Returns the high * wide * clrs samples, to be
+freed by the caller, or 0 when the stream has to be decoded row by row with ljpeg_row(): no restart
+markers, input not in memory, a single worker, or predictors using the row above (which crosses restart
+intervals in ljpeg_row(), so they are not independent).
+*/
+static unsigned short *
+ljpeg_decode_segments(struct jhead *jh) {
+    ThreadPool pool(OPTIONS_values->threads);
+    const unsigned char *end;
+    const unsigned char *p;
+    unsigned short *rows;
+    int jwide = jh->wide * jh->clrs;
+    int segmentRows;
+    int segments;
+    int s;
+    int w;
+
+    if ( jh->restart <= 0 || jh->restart % jh->wide || jh->restart / jh->wide >= jh->high || jh->psv != 1 ||
+         !inputInMemory() || pool.size() < 2 ) {
+        return 0;
+    }
+    segmentRows = jh->restart / jh->wide;
+    segments = (jh->high + segmentRows - 1) / segmentRows;
+
+    // Segment s is in [start[s], start[s + 1]), the restart marker closing it included
+    std::vector<const unsigned char *> start(segments + 1);
+    end = GLOBAL_IO_input.data + GLOBAL_IO_input.size;
+    p = start[0] = GLOBAL_IO_input.data + GLOBAL_IO_input.position;
+    for ( s = 1; s < segments; s++ ) {
+        while ( (p = (const unsigned char *) memchr(p, 0xff, MAX(end - p - 1, 0))) && p[1] >> 4 != 0xd ) {
+            p++;
+        }
+        if ( !p ) {
+            return 0;
+        }
+        start[s] = p += 2;
+    }
+    start[segments] = end;
+
+    rows = (unsigned short *) malloc((size_t) jh->high * jwide * sizeof *rows);
+    memoryError(rows, "ljpeg_decode_segments()");
+    std::vector<struct jhead> workers(pool.size(), *jh);
+    std::vector<unsigned> errors(segments, 0);
+    for ( w = 0; w < pool.size(); w++ ) {
+        workers[w].row = (unsigned short *) calloc(jwide, 4);
+        memoryError(workers[w].row, "ljpeg_decode_segments()");
+    }
+
+    pool.run(segments, [&](int segment, int worker) {
+        struct jhead *wh = &workers[worker];
+
+        wh->reader.restart(start[segment], start[segment + 1], 1);
+        ljpeg_decode_interval(wh, rows, segment * segmentRows, MIN(jh->high, (segment + 1) * segmentRows));
+        errors[segment] = wh->reader.errors;
+    });
+    for ( s = 0; s < segments; s++ ) {
+        if ( errors[s] ) {
+            GLOBAL_IO_input.position = start[s] - GLOBAL_IO_input.data;
+            workers[0].reader.restart();
+            ljpeg_decode_interval(&workers[0], rows, s * segmentRows, MIN(jh->high, (s + 1) * segmentRows));
+        }
+    }
+
+    for ( w = 0; w < pool.size(); w++ ) {
+        free(workers[w].row);
+    }
+    GLOBAL_IO_input.position = end - GLOBAL_IO_input.data;
+    return rows;
+}
+
 void
 lossless_jpeg_load_raw() {
     int jwide;
@@ -212,14 +431,16 @@ lossless_jpeg_load_raw() {
     int col = 0;
     struct jhead jh;
     unsigned short *rp;
+    unsigned short *rows;
 
     if ( !ljpeg_start(&jh, 0) ) {
         return;
     }
     jwide = jh.wide * jh.clrs;
+    rows = ljpeg_decode_segments(&jh);
 
     for ( jrow = 0; jrow < jh.high; jrow++ ) {
-        rp = ljpeg_row(jrow, &jh);
+        rp = rows ? rows + (size_t) jrow * jwide : ljpeg_row(jrow, &jh);
         if ( GLOBAL_loadFlags & 1 ) {
             row = jrow & 1 ? THE_image.height - 1 - jrow / 2 : jrow / 2;
         }
@@ -246,6 +467,7 @@ lossless_jpeg_load_raw() {
             }
         }
     }
+    free(rows);
     ljpeg_end(&jh);
 }
 
@@ -258,7 +480,7 @@ ljpeg_idct(struct jhead *jh) {
     int skip;
     int coef;
     float work[3][8][8];
-    static float cs[106] = {0};
+    static thread_local float cs[106] = {0};
     static const unsigned char zigzag[80] =
             {0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33,
              40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36,
@@ -271,14 +493,14 @@ ljpeg_idct(struct jhead *jh) {
         }
     }
     memset(work, 0, sizeof work);
-    work[0][0][0] = jh->vpred[0] += ljpeg_diff(jh->huff[0]) * jh->quant[0];
+    work[0][0][0] = jh->vpred[0] += ljpeg_diff(jh->reader, jh->diff[0]) * jh->quant[0];
     for ( i = 1; i < 64; i++ ) {
-        len = gethuff (jh->huff[16]);
+        len = jh->reader.getHuff(jh->huff[16]);
         i += skip = len >> 4;
         if ( !(len &= 15) && skip < 15 ) {
             break;
         }
-        coef = getbits(len);
+        coef = jh->reader.getBits(len);
         if ( (coef & (1 << (len - 1))) == 0 ) {
             coef -= (1 << len) - 1;
         }
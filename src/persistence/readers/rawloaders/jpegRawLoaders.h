@@ -1,6 +1,8 @@
 #ifndef __JPEG_RAW_LOADERS__
 #define __JPEG_RAW_LOADERS__
 
+#include "../BitReader.h"
+
 struct jhead {
     int algo;
     int bits;
@@ -10,18 +12,24 @@ struct jhead {
     int sraw;
     int psv;
     int restart;
+    unsigned tables; // Huffman tables defined, 1 << c for each, read even when only the frame is
     int vpred[6];
     unsigned short quant[64];
     unsigned short idct[64];
     unsigned short *huff[20];
     unsigned short *free[20];
+    struct HuffDiffTable *diff[6]; // For huff[c], c < clrs, shared when huff[c] is
     unsigned short *row;
+    BitReader reader;
 };
 
 extern int ljpeg_start(struct jhead *jh, int info_only);
+extern int ljpeg_start(struct jhead *jh, const unsigned char *begin, const unsigned char *end, unsigned dngVersion);
 extern void ljpeg_end(struct jhead *jh);
 extern unsigned short *ljpeg_row(int jrow, struct jhead *jh);
+extern unsigned short *ljpeg_decode_row(int jrow, struct jhead *jh);
 extern int ljpeg_diff(unsigned short *huff);
+extern int ljpeg_diff(BitReader &bits, const struct HuffDiffTable *table);
 extern void lossless_jpeg_load_raw();
 extern void ljpeg_idct(struct jhead *jh);
 
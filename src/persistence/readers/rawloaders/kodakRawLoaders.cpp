@@ -29,11 +29,11 @@ kodak_c330_load_raw() {
     pixel = (unsigned char *)calloc(THE_image.width, 2 * sizeof *pixel);
     memoryError(pixel, "kodak_c330_load_raw()");
     for ( row = 0; row < height; row++ ) {
-        if ( fread(pixel, THE_image.width, 2, GLOBAL_IO_ifp) < 2 ) {
+        if ( inputRead(pixel, THE_image.width, 2) < 2 ) {
             inputOutputError();
         }
         if ( GLOBAL_loadFlags && (row & 31) == 31 ) {
-            fseek(GLOBAL_IO_ifp, THE_image.width * 32, SEEK_CUR);
+            inputSeek(THE_image.width * 32, SEEK_CUR);
         }
         for ( col = 0; col < width; col++ ) {
             y = pixel[col * 2];
@@ -66,7 +66,7 @@ kodak_c603_load_raw() {
     memoryError(pixel, "kodak_c603_load_raw()");
     for ( row = 0; row < height; row++ ) {
         if ( ~row & 1 ) {
-            if ( fread(pixel, THE_image.width, 3, GLOBAL_IO_ifp) < 3 ) {
+            if ( inputRead(pixel, THE_image.width, 3) < 3 ) {
                 inputOutputError();
             }
         }
@@ -118,7 +118,7 @@ kodak_262_load_raw() {
     }
     for ( row = 0; row < THE_image.height; row++ ) {
         if ((row & 31) == 0 ) {
-            fseek(GLOBAL_IO_ifp, strip[row >> 5], SEEK_SET);
+            inputSeek(strip[row >> 5], SEEK_SET);
             getbits(-1);
             pi = 0;
         }
@@ -166,13 +166,13 @@ kodak_65000_decode(short *out, int bsize) {
     int len;
     int diff;
 
-    save = ftell(GLOBAL_IO_ifp);
+    save = inputTell();
     bsize = (bsize + 3) & -4;
     for ( i = 0; i < bsize; i += 2 ) {
-        c = fgetc(GLOBAL_IO_ifp);
+        c = inputGetc();
         if ( (blen[i] = c & 15) > 12 ||
              (blen[i + 1] = c >> 4) > 12 ) {
-            fseek(GLOBAL_IO_ifp, save, SEEK_SET);
+            inputSeek(save, SEEK_SET);
             for ( i = 0; i < bsize; i += 8 ) {
                 readShorts(raw, 6);
                 out[i] = raw[0] >> 12 << 8 | raw[2] >> 12 << 4 | raw[4] >> 12;
@@ -185,15 +185,15 @@ kodak_65000_decode(short *out, int bsize) {
         }
     }
     if ( (bsize & 7) == 4 ) {
-        bitbuf = fgetc(GLOBAL_IO_ifp) << 8;
-        bitbuf += fgetc(GLOBAL_IO_ifp);
+        bitbuf = inputGetc() << 8;
+        bitbuf += inputGetc();
         bits = 16;
     }
     for ( i = 0; i < bsize; i++ ) {
         len = blen[i];
         if ( bits < len ) {
             for ( j = 0; j < 32; j += 8 ) {
-                bitbuf += (long long) fgetc(GLOBAL_IO_ifp) << (bits + (j ^ 8));
+                bitbuf += (long long) inputGetc() << (bits + (j ^ 8));
             }
             bits += 32;
         }
@@ -318,10 +318,10 @@ kodak_thumb_load_raw() {
 
 METHODDEF(boolean)
 fill_input_buffer(j_decompress_ptr cinfo) {
-    static unsigned char jpeg_buffer[4096];
+    static thread_local unsigned char jpeg_buffer[4096];
     size_t nbytes;
 
-    nbytes = fread(jpeg_buffer, 1, 4096, GLOBAL_IO_ifp);
+    nbytes = inputRead(jpeg_buffer, 1, 4096);
     swab(jpeg_buffer, jpeg_buffer, nbytes);
     cinfo->src->next_input_byte = jpeg_buffer;
     cinfo->src->bytes_in_buffer = nbytes;
@@ -379,7 +379,7 @@ kodak_dc120_load_raw() {
     int col;
 
     for ( row = 0; row < height; row++ ) {
-        if ( fread(pixel, 1, 848, GLOBAL_IO_ifp) < 848 ) inputOutputError();
+        if ( inputRead(pixel, 1, 848) < 848 ) inputOutputError();
         shift = row * mul[row & 3] + add[row & 3];
         for ( col = 0; col < width; col++ ) {
             RAW(row, col) = (unsigned short) pixel[(col + shift) % 848];
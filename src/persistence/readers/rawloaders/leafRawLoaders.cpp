@@ -22,8 +22,8 @@ leaf_hdr_load_raw() {
     for ( c = 0; c < tiff_samples; c++ ) {
         for ( r = 0; r < THE_image.height; r++ ) {
             if ( r % tile_length == 0 ) {
-                fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset + 4 * tile++, SEEK_SET);
-                fseek(GLOBAL_IO_ifp, read4bytes(), SEEK_SET);
+                inputSeek(GLOBAL_IO_profileOffset + 4 * tile++, SEEK_SET);
+                inputSeek(read4bytes(), SEEK_SET);
             }
             if ( IMAGE_filters && c != OPTIONS_values->shotSelect ) {
                 continue;
@@ -1,6 +1,7 @@
 #include <cstring>
 #include "../../../common/globals.h"
 #include "../globalsio.h"
+#include "../BitReader.h"
 #include "../../../imageHandling/BayessianImage.h"
 #include "../../../postprocessors/gamma.h"
 #include "../../../common/mathMacros.h"
@@ -22,7 +23,10 @@ nikon_load_raw() {
                     8,    0x5c, 0x4b, 0x3a, 0x29, 7, 6,  5, 4,  3,  2,  1,  0,  13, 14},
             {0, 1, 4, 2, 2, 3, 1, 2, 0, 0, 0, 0, 0, 0, 0, 0,    /* 14-bit lossless */
                     7,    6,    8,    5,    9,    4, 10, 3, 11, 12, 2,  0,  1,  13, 14}};
+    BitReader bits;
     unsigned short *huff;
+    struct HuffDiffTable *table;
+    const struct HuffDiff *entry;
     unsigned short ver0;
     unsigned short ver1;
     unsigned short vpred[2][2];
@@ -40,11 +44,11 @@ nikon_load_raw() {
     int shl;
     int diff;
 
-    fseek(GLOBAL_IO_ifp, GLOBAL_meta_offset, SEEK_SET);
-    ver0 = fgetc(GLOBAL_IO_ifp);
-    ver1 = fgetc(GLOBAL_IO_ifp);
+    inputSeek(GLOBAL_meta_offset, SEEK_SET);
+    ver0 = inputGetc();
+    ver1 = inputGetc();
     if ( ver0 == 0x49 || ver1 == 0x58 ) {
-        fseek(GLOBAL_IO_ifp, 2110, SEEK_CUR);
+        inputSeek(2110, SEEK_CUR);
     }
     if ( ver0 == 0x46 ) {
         tree = 2;
@@ -65,7 +69,7 @@ nikon_load_raw() {
             GAMMA_curveFunctionLookupTable[i] = (GAMMA_curveFunctionLookupTable[i - i % step] * (step - i % step) +
                                                  GAMMA_curveFunctionLookupTable[i - i % step + step] * (i % step)) / step;
         }
-        fseek(GLOBAL_IO_ifp, GLOBAL_meta_offset + 562, SEEK_SET);
+        inputSeek(GLOBAL_meta_offset + 562, SEEK_SET);
         split = read2bytes();
     } else {
         if ( ver0 != 0x46 && csize <= 0x4001 ) {
@@ -76,21 +80,28 @@ nikon_load_raw() {
         max--;
     }
     huff = make_decoder(nikon_tree[tree]);
-    fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset, SEEK_SET);
-    getbits(-1);
+    table = make_diff_decoder(huff, HUFF_DIFF_NIKON);
+    inputSeek(GLOBAL_IO_profileOffset, SEEK_SET);
+    bits.restart();
     for ( min = row = 0; row < THE_image.height; row++ ) {
         if ( split && row == split ) {
+            free(table);
             free(huff);
             huff = make_decoder(nikon_tree[tree + 1]);
+            table = make_diff_decoder(huff, HUFF_DIFF_NIKON);
             max += (min = 16) << 1;
         }
         for ( col = 0; col < THE_image.width; col++ ) {
-            i = gethuff(huff);
-            len = i & 15;
-            shl = i >> 4;
-            diff = ((getbits(len - shl) << 1) + 1) << shl >> 1;
-            if ((diff & (1 << (len - 1))) == 0 ) {
-                diff -= (1 << len) - !shl;
+            if ( (entry = bits.getHuffDiff(table)) ) {
+                diff = entry->diff;
+            } else {
+                i = bits.getHuff(huff);
+                len = i & 15;
+                shl = i >> 4;
+                diff = ((bits.getBits(len - shl) << 1) + 1) << shl >> 1;
+                if ((diff & (1 << (len - 1))) == 0 ) {
+                    diff -= (1 << len) - !shl;
+                }
             }
             if ( col < 2 ) {
                 hpred[col] = vpred[row & 1][col] += diff;
@@ -103,6 +114,7 @@ nikon_load_raw() {
             RAW(row, col) = GAMMA_curveFunctionLookupTable[LIM((short)hpred[col & 1], 0, 0x3fff)];
         }
     }
+    free(table);
     free(huff);
 }
 
@@ -121,7 +133,7 @@ nikon_yuv_load_raw() {
             if ( !(b = col & 1)) {
                 bitbuf = 0;
                 for ( c = 0; c < 6; c++ ) {
-                    bitbuf |= (unsigned long long) fgetc(GLOBAL_IO_ifp) << c * 8;
+                    bitbuf |= (unsigned long long) inputGetc() << c * 8;
                 }
                 for ( c = 0; c < 4; c++ ) {
                     yuv[c] = (bitbuf >> c * 12 & 0xfff) - (c >> 1 << 11);
@@ -147,9 +159,9 @@ nikon_e995() {
     const unsigned char often[] = {0x00, 0x55, 0xaa, 0xff};
 
     memset(histo, 0, sizeof histo);
-    fseek(GLOBAL_IO_ifp, -2000, SEEK_END);
+    inputSeek(-2000, SEEK_END);
     for ( i = 0; i < 2000; i++ ) {
-        histo[fgetc(GLOBAL_IO_ifp)]++;
+        histo[inputGetc()]++;
     }
     for ( i = 0; i < 4; i++ ) {
         if ( histo[often[i]] < 200 ) {
@@ -167,9 +179,9 @@ nikon_e2100() {
     unsigned char t[12];
     int i;
 
-    fseek(GLOBAL_IO_ifp, 0, SEEK_SET);
+    inputSeek(0, SEEK_SET);
     for ( i = 0; i < 1024; i++ ) {
-        fread(t, 1, 12, GLOBAL_IO_ifp);
+        inputRead(t, 1, 12);
         if ( ((t[2] & t[4] & t[7] & t[9]) >> 4
               & t[1] & t[6] & t[8] & t[11] & 3) != 3 ) {
             return 0;
@@ -193,8 +205,8 @@ nikon_3700() {
             {0x32, "Nikon",   "E3700"},
             {0x33, "Olympus", "C740UZ"}};
 
-    fseek(GLOBAL_IO_ifp, 3072, SEEK_SET);
-    fread(dp, 1, 24, GLOBAL_IO_ifp);
+    inputSeek(3072, SEEK_SET);
+    inputRead(dp, 1, 24);
     bits = (dp[8] & 3) << 4 | (dp[20] & 3);
     for ( i = 0; i < sizeof table / sizeof *table; i++ )
         if ( bits == table[i].bits ) {
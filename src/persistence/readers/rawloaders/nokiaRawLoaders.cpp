@@ -23,7 +23,7 @@ nokia_load_raw() {
     data = (unsigned char *) malloc(dwide * 2);
     memoryError(data, "nokia_load_raw()");
     for ( row = 0; row < THE_image.height; row++ ) {
-        if ( fread(data + dwide, 1, dwide, GLOBAL_IO_ifp) < dwide ) inputOutputError();
+        if ( inputRead(data + dwide, 1, dwide) < dwide ) inputOutputError();
         for ( c = 0; c < dwide; c++ ) {
             data[c] = data[dwide + (c ^ rev)];
         }
@@ -30,7 +30,7 @@ olympus_load_raw() {
             huff[++n] = (i + 1) << 8 | i;
         }
     }
-    fseek(GLOBAL_IO_ifp, 7, SEEK_CUR);
+    inputSeek(7, SEEK_CUR);
     getbits(-1);
     for ( row = 0; row < height; row++ ) {
         memset(acarry, 0, sizeof acarry);
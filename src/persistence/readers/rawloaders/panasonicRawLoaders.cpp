@@ -4,16 +4,16 @@
 
 static unsigned
 pana_bits(int nbits) {
-    static unsigned char buf[0x4000];
-    static int vbits;
+    static thread_local unsigned char buf[0x4000];
+    static thread_local int vbits;
     int byte;
 
     if ( !nbits ) {
         return vbits = 0;
     }
     if ( !vbits ) {
-        fread(buf + GLOBAL_loadFlags, 1, 0x4000 - GLOBAL_loadFlags, GLOBAL_IO_ifp);
-        fread(buf, 1, GLOBAL_loadFlags, GLOBAL_IO_ifp);
+        inputRead(buf + GLOBAL_loadFlags, 1, 0x4000 - GLOBAL_loadFlags);
+        inputRead(buf, 1, GLOBAL_loadFlags);
     }
     vbits = (vbits - nbits) & 0x1ffff;
     byte = vbits >> 3 ^ 0x3ff0;
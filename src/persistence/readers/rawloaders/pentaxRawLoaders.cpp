@@ -18,14 +18,14 @@ pentax_load_raw() {
                                   {0, 0}};
     unsigned short hpred[2];
 
-    fseek(GLOBAL_IO_ifp, GLOBAL_meta_offset, SEEK_SET);
+    inputSeek(GLOBAL_meta_offset, SEEK_SET);
     dep = (read2bytes() + 12) & 15;
-    fseek(GLOBAL_IO_ifp, 12, SEEK_CUR);
+    inputSeek(12, SEEK_CUR);
     for ( c = 0; c < dep; c++ ) {
         bit[0][c] = read2bytes();
     }
     for ( c = 0; c < dep; c++ ) {
-        bit[1][c] = fgetc(GLOBAL_IO_ifp);
+        bit[1][c] = inputGetc();
     }
     for ( c = 0; c < dep; c++ ) {
         for ( i = bit[0][c]; i <= ((bit[0][c] + (4096 >> bit[1][c]) - 1) & 4095); ) {
@@ -33,7 +33,7 @@ pentax_load_raw() {
         }
     }
     huff[0] = 12;
-    fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset, SEEK_SET);
+    inputSeek(GLOBAL_IO_profileOffset, SEEK_SET);
     getbits(-1);
     for ( row = 0; row < THE_image.height; row++ ) {
         for ( col = 0; col < THE_image.width; col++ ) {
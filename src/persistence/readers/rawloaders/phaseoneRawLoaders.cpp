@@ -1,9 +1,11 @@
 #include <cmath>
 #include <climits>
+#include <vector>
 #include "../../../common/globals.h"
 #include "../../../common/mathMacros.h"
 #include "../../../common/util.h"
 #include "../../../common/Options.h"
+#include "../../../common/ThreadPool.h"
 #include "../../../imageHandling/BayessianImage.h"
 #include "../../../colorRepresentation/adobeCoeff.h"
 #include "../../../postprocessors/gamma.h"
@@ -85,11 +87,11 @@ phase_one_load_raw() {
     int i;
     unsigned short akey, bkey, mask;
 
-    fseek(GLOBAL_IO_ifp, ph1.key_off, SEEK_SET);
+    inputSeek(ph1.key_off, SEEK_SET);
     akey = read2bytes();
     bkey = read2bytes();
     mask = ph1.format == 1 ? 0x5555 : 0x1354;
-    fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset, SEEK_SET);
+    inputSeek(GLOBAL_IO_profileOffset, SEEK_SET);
     readShorts(THE_image.rawData, THE_image.width * THE_image.height);
     if ( ph1.format ) {
         for ( i = 0; i < THE_image.width * THE_image.height; i += 2 ) {
@@ -101,79 +103,249 @@ phase_one_load_raw() {
     }
 }
 
+/*
+ph1_bithuff() state kept by the caller: 32-bit words read from memory, bytes past end reading as 0xff as
+they do through read4bytes(), or from the input through read4bytes() when cursor is null.
+*/
+struct PhaseOneBits {
+    const unsigned char *cursor;
+    const unsigned char *end;
+    unsigned long long bitbuf;
+    int vbits;
+    int bigEndian;
+};
+
+// What phase_one_decode_row() needs of the decoding state, taken on the calling thread
+struct PhaseOneRows {
+    unsigned short *rawData;
+    const unsigned short *curve;
+    short (*cblack)[2];
+    short (*rblack)[2];
+    int width;
+    int format;
+    int black;
+    int splitCol;
+    int splitRow;
+};
+
+static inline unsigned
+phase_one_bits(struct PhaseOneBits *bits, int nbits) {
+    const unsigned char *p = bits->cursor;
+    unsigned word;
+    unsigned c;
+    int i;
+
+    if ( bits->vbits < nbits ) {
+        if ( !p ) {
+            word = read4bytes();
+        } else {
+            if ( bits->end - p >= 4 ) {
+                word = bits->bigEndian ? (unsigned) p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3]
+                                       : p[0] | p[1] << 8 | p[2] << 16 | (unsigned) p[3] << 24;
+                bits->cursor += 4;
+            } else {
+                for ( word = i = 0; i < 4; i++ ) {
+                    c = bits->cursor < bits->end ? *bits->cursor++ : 0xff;
+                    word = bits->bigEndian ? word << 8 | c : word | c << (i * 8);
+                }
+            }
+        }
+        bits->bitbuf = bits->bitbuf << 32 | word;
+        bits->vbits += 32;
+    }
+    c = bits->bitbuf << (64 - bits->vbits) >> (64 - nbits);
+    bits->vbits -= nbits;
+    return c;
+}
+
+/*
+Starts reading the row at offset, from memory when data is not null and through the input otherwise
+*/
+static void
+phase_one_start_row(struct PhaseOneBits *bits, const unsigned char *data, off_t offset) {
+    if ( data ) {
+        bits->cursor = offset >= 0 && offset < bits->end - data ? data + offset : bits->end;
+    } else {
+        inputSeek(offset, SEEK_SET);
+    }
+    bits->bitbuf = 0;
+    bits->vbits = 0;
+}
+
+/*
+Decodes a row and writes it with the column and row black levels applied. len holds the code lengths the
+row starts with, as left by the previous row, and those it ends with on return. Corrupt pixels are reported
+where they are found when reading through the input, only counted otherwise. Returns the number counted,
+or -1 when a length that is still 0 has to be used.
+*/
+static int
+phase_one_decode_row(struct PhaseOneBits *bits, const struct PhaseOneRows *rows, int row, int len[2]) {
+    static const int length[] = {8, 7, 6, 9, 11, 10, 5, 12, 14, 13};
+    unsigned short pixel;
+    int pred[2];
+    int errors = 0;
+    int col;
+    int i;
+    int j;
+
+    pred[0] = pred[1] = 0;
+    for ( col = 0; col < rows->width; col++ ) {
+        if ( col >= (rows->width & -8) ) {
+            len[0] = len[1] = 14;
+        } else {
+            if ( (col & 7) == 0 ) {
+                for ( i = 0; i < 2; i++ ) {
+                    for ( j = 0; j < 5 && !phase_one_bits(bits, 1); j++ );
+                    if ( j-- ) {
+                        len[i] = length[j * 2 + phase_one_bits(bits, 1)];
+                    }
+                }
+            }
+        }
+        if ( (i = len[col & 1]) == 14 ) {
+            pixel = pred[col & 1] = phase_one_bits(bits, 16);
+        } else {
+            if ( !i ) {
+                return -1;
+            }
+            pixel = pred[col & 1] += phase_one_bits(bits, i) + 1 - (1 << (i - 1));
+        }
+        if ( pred[col & 1] >> 16 ) {
+            if ( bits->end ) {
+                errors++;
+            } else {
+                inputOutputError();
+            }
+        }
+        if ( rows->format == 5 && pixel < 256 ) {
+            pixel = rows->curve[pixel];
+        }
+        i = (pixel << 2 * (rows->format != 8)) - rows->black
+            + rows->cblack[row][col >= rows->splitCol]
+            + rows->rblack[col][row >= rows->splitRow];
+        if ( i > 0 ) {
+            rows->rawData[(size_t) row * rows->width + col] = i;
+        }
+    }
+    return errors;
+}
+
+/*
+Decodes the row at offset again through the input, starting with the code lengths start, so that
+inputOutputError() reports its corrupt pixels at the file position they are read from
+*/
+static void
+phase_one_report_row(const struct PhaseOneBits *bits, const struct PhaseOneRows *rows, int row, off_t offset,
+                     const int start[2]) {
+    struct PhaseOneBits input = *bits;
+    int len[2];
+
+    input.cursor = input.end = nullptr;
+    len[0] = start[0];
+    len[1] = start[1];
+    phase_one_start_row(&input, nullptr, offset);
+    phase_one_decode_row(&input, rows, row, len);
+}
+
+/*
+Every row starts at its entry in a table of offsets. When the input is in memory rows are decoded on a
+ThreadPool, each with its own bits. A row that keeps the code lengths of the row above (its first codes
+give none) is decoded again once the rows before it are done. Rows read from memory that have corrupt pixels
+are decoded once more through the input, in order, to report them.
+*/
 void
 phase_one_load_raw_c() {
-    static const int length[] = {8, 7, 6, 9, 11, 10, 5, 12, 14, 13};
+    ThreadPool pool(OPTIONS_values->threads);
+    struct PhaseOneBits bits;
+    struct PhaseOneRows rows;
+    const unsigned char *data;
+    off_t base = GLOBAL_IO_profileOffset;
     int *offset;
     int len[2];
-    int pred[2];
+    int start[2];
     int row;
-    int col;
     int i;
-    int j;
-    unsigned short *pixel;
     short (*cblack)[2];
     short (*rblack)[2];
 
-    pixel = (unsigned short *) calloc(THE_image.width * 3 + THE_image.height * 4, 2);
-    memoryError(pixel, "phase_one_load_raw_c()");
-    offset = (int *) (pixel + THE_image.width);
-    fseek(GLOBAL_IO_ifp, strip_offset, SEEK_SET);
+    offset = (int *) calloc(THE_image.width * 2 + THE_image.height * 4, 2);
+    memoryError(offset, "phase_one_load_raw_c()");
+    inputSeek(strip_offset, SEEK_SET);
     for ( row = 0; row < THE_image.height; row++ ) {
         offset[row] = read4bytes();
     }
     cblack = (short (*)[2]) (offset + THE_image.height);
-    fseek(GLOBAL_IO_ifp, ph1.black_col, SEEK_SET);
+    inputSeek(ph1.black_col, SEEK_SET);
     if ( ph1.black_col ) {
         readShorts((unsigned short *) cblack[0], THE_image.height * 2);
     }
     rblack = cblack + THE_image.height;
-    fseek(GLOBAL_IO_ifp, ph1.black_row, SEEK_SET);
+    inputSeek(ph1.black_row, SEEK_SET);
     if ( ph1.black_row ) {
         readShorts((unsigned short *) rblack[0], THE_image.width * 2);
     }
     for ( i = 0; i < 256; i++ ) {
         GAMMA_curveFunctionLookupTable[i] = i * i / 3.969 + 0.5;
     }
-    for ( row = 0; row < THE_image.height; row++ ) {
-        fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset + offset[row], SEEK_SET);
-        ph1_bits(-1);
-        pred[0] = pred[1] = 0;
-        for ( col = 0; col < THE_image.width; col++ ) {
-            if ( col >= (THE_image.width & -8) ) {
-                len[0] = len[1] = 14;
-            } else {
-                if ((col & 7) == 0 ) {
-                    for ( i = 0; i < 2; i++ ) {
-                        for ( j = 0; j < 5 && !ph1_bits(1); j++ );
-                        if ( j-- ) {
-                            len[i] = length[j * 2 + ph1_bits(1)];
-                        }
-                    }
+
+    rows.rawData = THE_image.rawData;
+    rows.curve = GAMMA_curveFunctionLookupTable;
+    rows.cblack = cblack;
+    rows.rblack = rblack;
+    rows.width = THE_image.width;
+    rows.format = ph1.format;
+    rows.black = ph1.black;
+    rows.splitCol = ph1.split_col;
+    rows.splitRow = ph1.split_row;
+    bits.bigEndian = GLOBAL_endianOrder != LITTLE_ENDIAN_ORDER;
+    bits.cursor = bits.end = data = nullptr;
+    if ( inputInMemory() ) {
+        data = GLOBAL_IO_input.data;
+        bits.end = data + GLOBAL_IO_input.size;
+    }
+    len[0] = len[1] = 14;
+
+    if ( data && pool.size() > 1 ) {
+        std::vector<int> rowErrors(THE_image.height);
+        std::vector<int> lastLen(THE_image.height * 2);
+        pool.run(THE_image.height, [&](int job, int) {
+            struct PhaseOneBits own = bits;
+            off_t at = base + offset[job];
+            int *rowLen = &lastLen[job * 2];
+
+            phase_one_start_row(&own, data, at);
+            rowLen[0] = rowLen[1] = 0;
+            rowErrors[job] = phase_one_decode_row(&own, &rows, job, rowLen);
+        });
+        for ( row = 0; row < THE_image.height; row++ ) {
+            start[0] = start[1] = 0;
+            if ( rowErrors[row] < 0 ) {
+                if ( row ) {
+                    start[0] = lastLen[row * 2 - 2];
+                    start[1] = lastLen[row * 2 - 1];
+                } else {
+                    start[0] = start[1] = len[0];
                 }
+                lastLen[row * 2] = start[0];
+                lastLen[row * 2 + 1] = start[1];
+                phase_one_start_row(&bits, data, base + offset[row]);
+                rowErrors[row] = phase_one_decode_row(&bits, &rows, row, &lastLen[row * 2]);
             }
-            if ((i = len[col & 1]) == 14 ) {
-                pixel[col] = pred[col & 1] = ph1_bits(16);
-            } else {
-                pixel[col] = pred[col & 1] += ph1_bits(i) + 1 - (1 << (i - 1));
-            }
-            if ( pred[col & 1] >> 16 ) {
-                inputOutputError();
-            }
-            if ( ph1.format == 5 && pixel[col] < 256 ) {
-                pixel[col] = GAMMA_curveFunctionLookupTable[pixel[col]];
+            if ( rowErrors[row] > 0 ) {
+                phase_one_report_row(&bits, &rows, row, base + offset[row], start);
             }
         }
-        for ( col = 0; col < THE_image.width; col++ ) {
-            i = (pixel[col] << 2 * (ph1.format != 8)) - ph1.black
-                + cblack[row][col >= ph1.split_col]
-                + rblack[col][row >= ph1.split_row];
-            if ( i > 0 ) {
-                RAW(row, col) = i;
+    } else {
+        for ( row = 0; row < THE_image.height; row++ ) {
+            start[0] = len[0];
+            start[1] = len[1];
+            phase_one_start_row(&bits, data, base + offset[row]);
+            if ( phase_one_decode_row(&bits, &rows, row, len) > 0 ) {
+                phase_one_report_row(&bits, &rows, row, base + offset[row], start);
             }
         }
     }
-    free(pixel);
+    free(offset);
     ADOBE_maximum = 0xfffc - ph1.black;
 }
 
@@ -228,18 +400,18 @@ phase_one_correct() {
     if ( OPTIONS_values->verbose ) {
         fprintf(stderr, _("Phase One correction...\n"));
     }
-    fseek(GLOBAL_IO_ifp, GLOBAL_meta_offset, SEEK_SET);
+    inputSeek(GLOBAL_meta_offset, SEEK_SET);
     GLOBAL_endianOrder = read2bytes();
-    fseek(GLOBAL_IO_ifp, 6, SEEK_CUR);
-    fseek(GLOBAL_IO_ifp, GLOBAL_meta_offset + read4bytes(), SEEK_SET);
+    inputSeek(6, SEEK_CUR);
+    inputSeek(GLOBAL_meta_offset + read4bytes(), SEEK_SET);
     entries = read4bytes();
     read4bytes();
     while ( entries-- ) {
         tag = read4bytes();
         len = read4bytes();
         data = read4bytes();
-        save = ftell(GLOBAL_IO_ifp);
-        fseek(GLOBAL_IO_ifp, GLOBAL_meta_offset + data, SEEK_SET);
+        save = inputTell();
+        inputSeek(GLOBAL_meta_offset + data, SEEK_SET);
         if ( tag == 0x419 ) {
             // Polynomial curve
             for ( read4bytes(), i = 0; i < 8; i++ ) {
@@ -325,11 +497,11 @@ phase_one_correct() {
                                 phase_one_flat_field(0, 4);
                             } else {
                                 if ( tag == 0x412 ) {
-                                    fseek(GLOBAL_IO_ifp, 36, SEEK_CUR);
+                                    inputSeek(36, SEEK_CUR);
                                     diff = abs(read2bytes() - ph1.tag_21a);
                                     if ( mindiff > diff ) {
                                         mindiff = diff;
-                                        off_412 = ftell(GLOBAL_IO_ifp) - 38;
+                                        off_412 = inputTell() - 38;
                                     }
                                 } else {
                                     if ( tag == 0x41f && !qlin_applied ) {
@@ -449,10 +621,10 @@ phase_one_correct() {
                 }
             }
         }
-        fseek(GLOBAL_IO_ifp, save, SEEK_SET);
+        inputSeek(save, SEEK_SET);
     }
     if ( off_412 ) {
-        fseek(GLOBAL_IO_ifp, off_412, SEEK_SET);
+        inputSeek(off_412, SEEK_SET);
         for ( i = 0; i < 9; i++ ) {
             head[i] = read4bytes() & 0x7fff;
         }
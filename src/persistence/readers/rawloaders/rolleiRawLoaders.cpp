@@ -33,7 +33,7 @@ rollei_load_raw() {
     unsigned todo[16];
 
     isix = THE_image.width * THE_image.height * 5 / 8;
-    while ( fread(pixel, 1, 10, GLOBAL_IO_ifp) == 10 ) {
+    while ( inputRead(pixel, 1, 10) == 10 ) {
         for ( i = 0; i < 10; i += 2 ) {
             todo[i] = iten++;
             todo[i + 1] = pixel[i] << 8 | pixel[i + 1];
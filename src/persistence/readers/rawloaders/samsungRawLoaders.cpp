@@ -17,8 +17,8 @@ samsung_load_raw() {
 
     GLOBAL_endianOrder = LITTLE_ENDIAN_ORDER;
     for ( row = 0; row < THE_image.height; row++ ) {
-        fseek(GLOBAL_IO_ifp, strip_offset + row * 4, SEEK_SET);
-        fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset + read4bytes(), SEEK_SET);
+        inputSeek(strip_offset + row * 4, SEEK_SET);
+        inputSeek(GLOBAL_IO_profileOffset + read4bytes(), SEEK_SET);
         ph1_bits(-1);
         for ( c = 0; c < 4; c++ ) {
             len[c] = row < 2 ? 7 : 4;
@@ -114,11 +114,11 @@ samsung3_load_raw() {
     unsigned short *prow[2];
 
     GLOBAL_endianOrder = LITTLE_ENDIAN_ORDER;
-    fseek(GLOBAL_IO_ifp, 9, SEEK_CUR);
-    opt = fgetc(GLOBAL_IO_ifp);
+    inputSeek(9, SEEK_CUR);
+    opt = inputGetc();
     init = (read2bytes(), read2bytes());
     for ( row = 0; row < THE_image.height; row++ ) {
-        fseek(GLOBAL_IO_ifp, (GLOBAL_IO_profileOffset - ftell(GLOBAL_IO_ifp)) & 15, SEEK_CUR);
+        inputSeek((GLOBAL_IO_profileOffset - inputTell()) & 15, SEEK_CUR);
         ph1_bits(-1);
         mag = 0;
         pmode = 7;
@@ -18,16 +18,16 @@ sinar_4shot_load_raw() {
 
     if ( THE_image.rawData ) {
         shot = LIM (OPTIONS_values->shotSelect, 1, 4) - 1;
-        fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset + shot * 4, SEEK_SET);
-        fseek(GLOBAL_IO_ifp, read4bytes(), SEEK_SET);
+        inputSeek(GLOBAL_IO_profileOffset + shot * 4, SEEK_SET);
+        inputSeek(read4bytes(), SEEK_SET);
         unpacked_load_raw();
         return;
     }
     pixel = (unsigned short *) calloc(THE_image.width, sizeof *pixel);
     memoryError(pixel, "sinar_4shot_load_raw()");
     for ( shot = 0; shot < 4; shot++ ) {
-        fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset + shot * 4, SEEK_SET);
-        fseek(GLOBAL_IO_ifp, read4bytes(), SEEK_SET);
+        inputSeek(GLOBAL_IO_profileOffset + shot * 4, SEEK_SET);
+        inputSeek(read4bytes(), SEEK_SET);
         for ( row = 0; row < THE_image.height; row++ ) {
             readShorts(pixel, THE_image.width);
             if ( (r = row - top_margin - (shot >> 1 & 1)) >= height ) {
@@ -1,16 +1,25 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SONY_ARW2_X86
+#include <immintrin.h>
+#endif
+
 #include "../../../common/globals.h"
+#include "../../../common/Options.h"
+#include "../../../common/ThreadPool.h"
 #include "../../../common/util.h"
+#include "../../../common/cpuFeatures.h"
 #include "../../../colorRepresentation/adobeCoeff.h"
 #include "../../../postprocessors/gamma.h"
 #include "../../../imageHandling/BayessianImage.h"
 #include "../globalsio.h"
+#include "../BitReader.h"
 #include "jpegRawLoaders.h"
 #include "sonyRawLoaders.h"
 
 void
 sony_decrypt(unsigned *data, int len, int start, int key) {
-    static unsigned pad[128];
-    static unsigned p;
+    static thread_local unsigned pad[128];
+    static thread_local unsigned p;
 
     if ( start ) {
         for ( p = 0; p < 4; p++ ) {
@@ -38,20 +47,20 @@ sony_load_raw() {
     unsigned row;
     unsigned col;
 
-    fseek(GLOBAL_IO_ifp, 200896, SEEK_SET);
-    fseek(GLOBAL_IO_ifp, (unsigned)fgetc(GLOBAL_IO_ifp) * 4 - 1, SEEK_CUR);
+    inputSeek(200896, SEEK_SET);
+    inputSeek((unsigned)inputGetc() * 4 - 1, SEEK_CUR);
     GLOBAL_endianOrder = BIG_ENDIAN_ORDER;
     key = read4bytes();
-    fseek(GLOBAL_IO_ifp, 164600, SEEK_SET);
-    fread(head, 1, 40, GLOBAL_IO_ifp);
+    inputSeek(164600, SEEK_SET);
+    inputRead(head, 1, 40);
     sony_decrypt((unsigned *)head, 10, 1, key);
     for ( i = 26; i-- > 22; ) {
         key = key << 8 | head[i];
     }
-    fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset, SEEK_SET);
+    inputSeek(GLOBAL_IO_profileOffset, SEEK_SET);
     for ( row = 0; row < THE_image.height; row++ ) {
         pixel = THE_image.rawData + row * THE_image.width;
-        if ( fread(pixel, 2, THE_image.width, GLOBAL_IO_ifp) < THE_image.width ) {
+        if ( inputRead(pixel, 2, THE_image.width) < THE_image.width ) {
             inputOutputError();
         }
         sony_decrypt((unsigned *)pixel, THE_image.width / 2, !row, key);
@@ -66,7 +75,9 @@ sony_load_raw() {
 
 void
 sony_arw_load_raw() {
+    BitReader bits;
     unsigned short huff[32770];
+    struct HuffDiffTable *table;
     static const unsigned short tab[18] =
             {0xf11, 0xf10, 0xe0f, 0xd0e, 0xc0d, 0xb0c, 0xa0b, 0x90a, 0x809,
              0x708, 0x607, 0x506, 0x405, 0x304, 0x303, 0x300, 0x202, 0x201};
@@ -83,13 +94,14 @@ sony_arw_load_raw() {
             huff[++n] = tab[i];
         }
     }
-    getbits(-1);
+    table = make_diff_decoder(huff, HUFF_DIFF_LJPEG);
+    bits.restart();
     for ( col = THE_image.width; col--; ) {
         for ( row = 0; row < THE_image.height + 1; row += 2 ) {
             if ( row == THE_image.height ) {
                 row = 1;
             }
-            if ( (sum += ljpeg_diff(huff)) >> 12 ) {
+            if ( (sum += ljpeg_diff(bits, table)) >> 12 ) {
                 inputOutputError();
             }
             if ( row < THE_image.height ) {
@@ -97,18 +109,18 @@ sony_arw_load_raw() {
             }
         }
     }
+    free(table);
 }
 
-/**
-Used by SONY A7RIV camera on 12 bits loosely compressed RAW files.
+/*
+Decodes the 16 pixels of a 128-bit sony_arw2_load_raw() block: 11-bit maximum and minimum, the 4-bit
+indexes of their pixels and a 7-bit delta, shifted by sh, for each of the other pixels. Bytes past end
+are read as zeros.
 */
-void
-sony_arw2_load_raw() {
-    unsigned char *data;
-    unsigned char *dp;
-    unsigned short pix[16];
-    int row;
-    int col;
+static void
+sony_arw2_block(const unsigned char *dp, const unsigned char *end, int bigEndian, unsigned short pix[16]) {
+    const unsigned char *p;
+    unsigned head;
     int val;
     int max;
     int min;
@@ -118,38 +130,244 @@ sony_arw2_load_raw() {
     int bit;
     int i;
 
-    data = (unsigned char *)malloc(THE_image.width + 1);
-    memoryError(data, "sony_arw2_load_raw()");
-    for ( row = 0; row < THE_image.height; row++ ) {
-        fread(data, 1, THE_image.width, GLOBAL_IO_ifp);
-        for ( dp = data, col = 0; col < THE_image.width - 30; dp += 16 ) {
-            max = 0x7ff & (val = unsignedEndianSwap(dp));
-            min = 0x7ff & val >> 11;
-            imax = 0x0f & val >> 22;
-            imin = 0x0f & val >> 26;
-            for ( sh = 0; sh < 4 && 0x80 << sh <= max - min; sh++ );
-            for ( bit = 30, i = 0; i < 16; i++ ) {
-                if ( i == imax ) {
-                    pix[i] = max;
-                } else {
-                    if ( i == imin ) {
-                        pix[i] = min;
-                    } else {
-                        pix[i] = ((unsignedShortEndianSwap(dp + (bit >> 3)) >> (bit & 7) & 0x7f) << sh) + min;
-                        if ( pix[i] > 0x7ff ) {
-                            pix[i] = 0x7ff;
-                        }
-                        bit += 7;
-                    }
+    head = bigEndian ? (unsigned) dp[0] << 24 | dp[1] << 16 | dp[2] << 8 | dp[3]
+                     : dp[0] | dp[1] << 8 | dp[2] << 16 | (unsigned) dp[3] << 24;
+    max = 0x7ff & head;
+    min = 0x7ff & head >> 11;
+    imax = 0x0f & head >> 22;
+    imin = 0x0f & head >> 26;
+    for ( sh = 0; sh < 4 && 0x80 << sh <= max - min; sh++ );
+    for ( bit = 30, i = 0; i < 16; i++ ) {
+        if ( i == imax ) {
+            pix[i] = max;
+        } else {
+            if ( i == imin ) {
+                pix[i] = min;
+            } else {
+                p = dp + (bit >> 3);
+                val = p < end ? p[0] : 0;
+                val = bigEndian ? val << 8 | (p + 1 < end ? p[1] : 0) : val | (p + 1 < end ? p[1] << 8 : 0);
+                pix[i] = ((val >> (bit & 7) & 0x7f) << sh) + min;
+                if ( pix[i] > 0x7ff ) {
+                    pix[i] = 0x7ff;
                 }
+                bit += 7;
             }
+        }
+    }
+}
 
-            // Gamma correction at loading time to scale to same 14-bit data range
-            for ( i = 0; i < 16; i++, col += 2 ) {
-                RAW(row, col) = GAMMA_curveFunctionLookupTable[pix[i] << 1] >> 2;
-            }
-            col -= col & 1 ? 1 : 31;
+#ifdef SONY_ARW2_X86
+
+/*
+sony_arw2_block() for a little endian block whose maximum and minimum are on different pixels. The 14 deltas
+are taken in two vectors, 8 + 6, each from the 2 bytes it spans, shifted to the top of its 16-bit lane by a
+multiplication and back down by 9. Pixel i then takes delta i minus the special pixels before it.
+*/
+__attribute__((target("sse4.1")))
+static inline void
+sony_arw2_block_sse41(const unsigned char *dp, unsigned head, __m128i *low, __m128i *high) {
+    const __m128i deltaShuffle0 = _mm_setr_epi8(3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 9, 10);
+    const __m128i deltaShuffle1 =
+        _mm_setr_epi8(10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15, -128, -128, -128, -128, -128);
+    const __m128i deltaScale0 = _mm_setr_epi16(8, 16, 32, 64, 128, 256, 512, 4);
+    const __m128i deltaScale1 = _mm_setr_epi16(8, 16, 32, 64, 128, 256, 0, 0);
+    __m128i in;
+    __m128i delta0;
+    __m128i delta1;
+    __m128i maxV;
+    __m128i minV;
+    __m128i imaxV;
+    __m128i iminV;
+    __m128i index;
+    __m128i k;
+    __m128i kb;
+    __m128i pix;
+    __m128i half[2];
+    int max;
+    int min;
+    int sh;
+    int h;
+
+    max = 0x7ff & head;
+    min = 0x7ff & head >> 11;
+    for ( sh = 0; sh < 4 && 0x80 << sh <= max - min; sh++ );
+    maxV = _mm_set1_epi16((short) max);
+    minV = _mm_set1_epi16((short) min);
+    imaxV = _mm_set1_epi16((short) (0x0f & head >> 22));
+    iminV = _mm_set1_epi16((short) (0x0f & head >> 26));
+
+    in = _mm_loadu_si128((const __m128i *) dp);
+    delta0 = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(in, deltaShuffle0), deltaScale0), 9);
+    delta1 = _mm_srli_epi16(_mm_mullo_epi16(_mm_shuffle_epi8(in, deltaShuffle1), deltaScale1), 9);
+    delta0 = _mm_sll_epi16(delta0, _mm_cvtsi32_si128(sh));
+    delta1 = _mm_sll_epi16(delta1, _mm_cvtsi32_si128(sh));
+
+    for ( h = 0; h < 2; h++ ) {
+        index = _mm_add_epi16(_mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), _mm_set1_epi16((short) (h * 8)));
+        k = _mm_add_epi16(_mm_add_epi16(index, _mm_cmpgt_epi16(index, imaxV)), _mm_cmpgt_epi16(index, iminV));
+        kb = _mm_add_epi16(_mm_mullo_epi16(k, _mm_set1_epi16(0x202)), _mm_set1_epi16(0x100));
+        pix = _mm_or_si128(
+            _mm_shuffle_epi8(delta0,
+                             _mm_or_si128(kb, _mm_and_si128(_mm_cmpgt_epi16(k, _mm_set1_epi16(7)),
+                                                            _mm_set1_epi16((short) 0x8080)))),
+            _mm_shuffle_epi8(delta1,
+                             _mm_or_si128(_mm_sub_epi16(kb, _mm_set1_epi16(0x1010)),
+                                          _mm_and_si128(_mm_cmplt_epi16(k, _mm_set1_epi16(8)),
+                                                        _mm_set1_epi16((short) 0x8080)))));
+        pix = _mm_min_epu16(_mm_add_epi16(pix, minV), _mm_set1_epi16(0x7ff));
+        pix = _mm_blendv_epi8(pix, minV, _mm_cmpeq_epi16(index, iminV));
+        pix = _mm_blendv_epi8(pix, maxV, _mm_cmpeq_epi16(index, imaxV));
+        half[h] = pix;
+    }
+    *low = half[0];
+    *high = half[1];
+}
+
+__attribute__((target("sse4.1")))
+static int
+sony_arw2_block_vector(const unsigned char *dp, unsigned short pix[16]) {
+    __m128i low;
+    __m128i high;
+    unsigned head = dp[0] | dp[1] << 8 | dp[2] << 16 | (unsigned) dp[3] << 24;
+
+    if ( (head >> 22 & 0x0f) == (head >> 26 & 0x0f) ) {
+        return 0;
+    }
+    sony_arw2_block_sse41(dp, head, &low, &high);
+    _mm_storeu_si128((__m128i *) pix, low);
+    _mm_storeu_si128((__m128i *) (pix + 8), high);
+    return 1;
+}
+
+/*
+Maps 16 interleaved pixels through the curve with two gathers of 8, each one reading curve[pix << 1] and the
+entry after it, and stores them in a row
+*/
+__attribute__((target("avx2")))
+static inline void
+sony_arw2_curve_avx2(__m128i low, __m128i high, const unsigned short *curve, unsigned short *out) {
+    const __m256i mask = _mm256_set1_epi32(0xffff);
+    __m256i a;
+    __m256i b;
+
+    a = _mm256_i32gather_epi32((const int *) curve, _mm256_slli_epi32(_mm256_cvtepu16_epi32(low), 1), 2);
+    b = _mm256_i32gather_epi32((const int *) curve, _mm256_slli_epi32(_mm256_cvtepu16_epi32(high), 1), 2);
+    a = _mm256_srli_epi32(_mm256_and_si256(a, mask), 2);
+    b = _mm256_srli_epi32(_mm256_and_si256(b, mask), 2);
+    _mm256_storeu_si256((__m256i *) out, _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xd8));
+}
+
+/*
+Decodes the block at dp, 16 even columns, and the one after it, the odd columns in between, into 32 columns.
+Returns 0 when one of them has its maximum and minimum on the same pixel.
+*/
+__attribute__((target("avx2")))
+static int
+sony_arw2_pair_avx2(const unsigned char *dp, const unsigned short *curve, unsigned short *out) {
+    __m128i even0;
+    __m128i even1;
+    __m128i odd0;
+    __m128i odd1;
+    unsigned head0 = dp[0] | dp[1] << 8 | dp[2] << 16 | (unsigned) dp[3] << 24;
+    unsigned head1 = dp[16] | dp[17] << 8 | dp[18] << 16 | (unsigned) dp[19] << 24;
+
+    if ( (head0 >> 22 & 0x0f) == (head0 >> 26 & 0x0f) || (head1 >> 22 & 0x0f) == (head1 >> 26 & 0x0f) ) {
+        return 0;
+    }
+    sony_arw2_block_sse41(dp, head0, &even0, &even1);
+    sony_arw2_block_sse41(dp + 16, head1, &odd0, &odd1);
+    sony_arw2_curve_avx2(_mm_unpacklo_epi16(even0, odd0), _mm_unpackhi_epi16(even0, odd0), curve, out);
+    sony_arw2_curve_avx2(_mm_unpacklo_epi16(even1, odd1), _mm_unpackhi_epi16(even1, odd1), curve, out + 16);
+    return 1;
+}
+
+#endif
+
+/*
+0: blocks decoded one pixel at a time, 1: SSE4.1, 2: SSE4.1 and AVX2 for pairs of blocks
+*/
+static int
+sony_arw2_vector_level() {
+#ifdef SONY_ARW2_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        return 2;
+    }
+    if ( cpuFeatures() & CPU_SSE41 ) {
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+/*
+Decodes a row of width bytes holding width pixels. A block holds 16 pixels of every other column: the even
+columns of 32 and then the odd ones. Only reads and writes what it is given, so rows can be decoded on any
+thread.
+*/
+static void
+sony_arw2_row(const unsigned char *data, unsigned short *raw, int width, const unsigned short *curve, int bigEndian) {
+    static const int level = sony_arw2_vector_level();
+    const unsigned char *dp;
+    unsigned short pix[16];
+    int col;
+    int i;
+    int decoded;
+
+    for ( dp = data, col = 0; col < width - 30; dp += 16 ) {
+#ifdef SONY_ARW2_X86
+        if ( !bigEndian && level == 2 && !(col & 1) && col + 1 < width - 30 &&
+             sony_arw2_pair_avx2(dp, curve, raw + col) ) {
+            dp += 16;
+            col += 32;
+            continue;
         }
+        decoded = !bigEndian && level && sony_arw2_block_vector(dp, pix);
+#else
+        decoded = 0;
+#endif
+        if ( !decoded ) {
+            sony_arw2_block(dp, data + width, bigEndian, pix);
+        }
+
+        // Gamma correction at loading time to scale to same 14-bit data range
+        for ( i = 0; i < 16; i++, col += 2 ) {
+            raw[col] = curve[pix[i] << 1] >> 2;
+        }
+        col -= col & 1 ? 1 : 31;
+    }
+}
+
+/**
+Used by SONY A7RIV camera on 12 bits loosely compressed RAW files.
+Rows are independent: when the input is in memory they are decoded on a ThreadPool.
+*/
+void
+sony_arw2_load_raw() {
+    ThreadPool pool(OPTIONS_values->threads);
+    const unsigned char *source;
+    unsigned char *data;
+    unsigned short *rawData = THE_image.rawData;
+    const unsigned short *curve = GAMMA_curveFunctionLookupTable;
+    int width = THE_image.width;
+    int bigEndian = GLOBAL_endianOrder != LITTLE_ENDIAN_ORDER;
+    int row;
+
+    if ( pool.size() > 1 && inputInMemory() && GLOBAL_IO_input.position >= 0 &&
+         GLOBAL_IO_input.position + (off_t) width * THE_image.height <= GLOBAL_IO_input.size ) {
+        source = GLOBAL_IO_input.data + GLOBAL_IO_input.position;
+        pool.run(THE_image.height, [&](int job, int) {
+            sony_arw2_row(source + (size_t) job * width, rawData + (size_t) job * width, width, curve, bigEndian);
+        });
+        inputSeek((off_t) width * THE_image.height, SEEK_CUR);
+        return;
+    }
+
+    data = (unsigned char *)malloc(THE_image.width + 1);
+    memoryError(data, "sony_arw2_load_raw()");
+    for ( row = 0; row < THE_image.height; row++ ) {
+        inputRead(data, 1, THE_image.width);
+        sony_arw2_row(data, &RAW(row, 0), width, curve, bigEndian);
     }
     free(data);
 }
@@ -2,6 +2,7 @@
 #include "../../../colorRepresentation/adobeCoeff.h"
 #include "../../../imageHandling/BayessianImage.h"
 #include "../globalsio.h"
+#include "../packedRows.h"
 #include "standardRawLoaders.h"
 
 void
@@ -35,6 +36,7 @@ packed_load_raw() {
     int col;
     int val;
     int i;
+    int wholeRows;
     unsigned long long bitbuf = 0;
 
     bwide = THE_image.width * THE_image.bitsPerSample / 8;
@@ -45,32 +47,49 @@ packed_load_raw() {
     }
     bite = 8 + (GLOBAL_loadFlags & 56);
     half = (THE_image.height + 1) >> 1;
+
+    // Rows starting at a word boundary, with no byte between samples or column swapping, are unpacked
+    // straight from the input in memory
+    wholeRows = inputInMemory() && !(GLOBAL_loadFlags & 1) && !(GLOBAL_loadFlags >> 6 & 3) && bite <= 16 &&
+                THE_image.bitsPerSample <= 16 && rbits >= 0 && bwide * 8 % bite == 0;
     for ( irow = 0; irow < THE_image.height; irow++ ) {
         row = irow;
         if ( GLOBAL_loadFlags & 2 &&
              (row = irow % half * 2 + irow / half) == 1 &&
              GLOBAL_loadFlags & 4 ) {
             if ( vbits = 0, tiff_compress ) {
-                fseek(GLOBAL_IO_ifp, GLOBAL_IO_profileOffset - (-half * bwide & -2048), SEEK_SET);
+                inputSeek(GLOBAL_IO_profileOffset - (-half * bwide & -2048), SEEK_SET);
             } else {
-                fseek(GLOBAL_IO_ifp, 0, SEEK_END);
-                fseek(GLOBAL_IO_ifp, ftell(GLOBAL_IO_ifp) >> 3 << 2, SEEK_SET);
+                inputSeek(0, SEEK_END);
+                inputSeek(inputTell() >> 3 << 2, SEEK_SET);
             }
         }
+        if ( wholeRows && !vbits && GLOBAL_IO_input.position + bwide <= GLOBAL_IO_input.size ) {
+            unpackPackedRow(GLOBAL_IO_input.data + GLOBAL_IO_input.position,
+                            GLOBAL_IO_input.size - GLOBAL_IO_input.position,
+                            &RAW(row, 0), THE_image.width, THE_image.bitsPerSample, bite >> 3);
+            inputSeek(bwide, SEEK_CUR);
+            continue;
+        }
         for ( col = 0; col < THE_image.width; col++ ) {
             for ( vbits -= THE_image.bitsPerSample; vbits < 0; vbits += bite ) {
                 bitbuf <<= bite;
                 for ( i = 0; i < bite; i += 8 ) {
-                    bitbuf |= ((unsigned long long) fgetc(GLOBAL_IO_ifp) << i);
+                    bitbuf |= ((unsigned long long) inputGetc() << i);
                 }
             }
             val = bitbuf << (64 - THE_image.bitsPerSample - vbits) >> (64 - THE_image.bitsPerSample);
             RAW(row, col ^ (GLOBAL_loadFlags >> 6 & 3)) = val;
-            if ( GLOBAL_loadFlags & 1 && (col % 10) == 9 && fgetc(GLOBAL_IO_ifp) &&
+            if ( GLOBAL_loadFlags & 1 && (col % 10) == 9 && inputGetc() &&
                  row < THE_image.height + top_margin && col < THE_image.width + left_margin ) {
                 inputOutputError();
             }
         }
         vbits -= rbits;
+        if ( wholeRows && vbits < 0 ) {
+            // Skip the padding now, as the next row would
+            inputSeek(-vbits >> 3, SEEK_CUR);
+            vbits = 0;
+        }
     }
 }
@@ -5,4 +5,4 @@
 #include "../common/mathMacros.h"
 #include "../imageHandling/BayessianImage.h"
 
-unsigned short GAMMA_curveFunctionLookupTable[GAMMA_TABLE_FUNCTION_SIZE];
+thread_local unsigned short GAMMA_curveFunctionLookupTable[GAMMA_TABLE_FUNCTION_SIZE];
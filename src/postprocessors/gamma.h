@@ -4,6 +4,6 @@
 // This is of size 0x10000 or 2^16, 64KiBytes
 #define GAMMA_TABLE_FUNCTION_SIZE 65536
 
-extern unsigned short GAMMA_curveFunctionLookupTable[GAMMA_TABLE_FUNCTION_SIZE];
+extern thread_local unsigned short GAMMA_curveFunctionLookupTable[GAMMA_TABLE_FUNCTION_SIZE];
 
 #endif
@@ -0,0 +1,210 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MEDIAN_FILTER_X86
+#include <immintrin.h>
+#endif
+
+#include "../common/cpuFeatures.h"
+#include "medianFilter.h"
+
+// Sorts a prefix of the columns into low, middle and high, returns the number of columns sorted
+typedef int (*SortKernel)(const int *above, const int *row, const int *below, int count, int *low, int *middle, int *high);
+
+// Takes the medians of a prefix of the neighbourhoods, returns the number of medians taken
+typedef int (*MedianKernel)(const int *low, const int *middle, const int *high, int count, int *out);
+
+struct MedianKernels {
+    SortKernel sort;
+    MedianKernel median;
+};
+
+static inline int
+minimum(int a, int b) {
+    return a < b ? a : b;
+}
+
+static inline int
+maximum(int a, int b) {
+    return a > b ? a : b;
+}
+
+static inline int
+median3(int a, int b, int c) {
+    return maximum(minimum(a, b), minimum(maximum(a, b), c));
+}
+
+static void
+sortScalar(const int *above, const int *row, const int *below, int first, int count, int *low, int *middle, int *high) {
+    int i;
+    int a;
+    int b;
+    int c;
+
+    for ( i = first; i < count; i++ ) {
+        a = minimum(above[i], row[i]);
+        b = maximum(above[i], row[i]);
+        c = below[i];
+        low[i] = minimum(a, c);
+        middle[i] = median3(a, b, c);
+        high[i] = maximum(b, c);
+    }
+}
+
+static void
+medianScalar(const int *low, const int *middle, const int *high, int first, int count, int *out) {
+    int i;
+
+    for ( i = first; i < count; i++ ) {
+        out[i] = median3(maximum(maximum(low[i], low[i + 1]), low[i + 2]),
+                         median3(middle[i], middle[i + 1], middle[i + 2]),
+                         minimum(minimum(high[i], high[i + 1]), high[i + 2]));
+    }
+}
+
+#ifdef MEDIAN_FILTER_X86
+
+__attribute__((target("sse4.1")))
+static inline __m128i
+median3Sse41(__m128i a, __m128i b, __m128i c) {
+    return _mm_max_epi32(_mm_min_epi32(a, b), _mm_min_epi32(_mm_max_epi32(a, b), c));
+}
+
+__attribute__((target("sse4.1")))
+static int
+sortSse41(const int *above, const int *row, const int *below, int count, int *low, int *middle, int *high) {
+    __m128i a;
+    __m128i b;
+    __m128i c;
+    __m128i t;
+    int i;
+
+    for ( i = 0; i + 4 <= count; i += 4 ) {
+        a = _mm_loadu_si128((const __m128i *) (above + i));
+        b = _mm_loadu_si128((const __m128i *) (row + i));
+        c = _mm_loadu_si128((const __m128i *) (below + i));
+        t = _mm_min_epi32(a, b);
+        b = _mm_max_epi32(a, b);
+        _mm_storeu_si128((__m128i *) (low + i), _mm_min_epi32(t, c));
+        _mm_storeu_si128((__m128i *) (middle + i), median3Sse41(t, b, c));
+        _mm_storeu_si128((__m128i *) (high + i), _mm_max_epi32(b, c));
+    }
+    return i;
+}
+
+__attribute__((target("sse4.1")))
+static int
+medianSse41(const int *low, const int *middle, const int *high, int count, int *out) {
+    __m128i lows;
+    __m128i middles;
+    __m128i highs;
+    int i;
+
+    for ( i = 0; i + 4 <= count; i += 4 ) {
+        lows = _mm_max_epi32(_mm_max_epi32(_mm_loadu_si128((const __m128i *) (low + i)),
+                                           _mm_loadu_si128((const __m128i *) (low + i + 1))),
+                             _mm_loadu_si128((const __m128i *) (low + i + 2)));
+        middles = median3Sse41(_mm_loadu_si128((const __m128i *) (middle + i)),
+                               _mm_loadu_si128((const __m128i *) (middle + i + 1)),
+                               _mm_loadu_si128((const __m128i *) (middle + i + 2)));
+        highs = _mm_min_epi32(_mm_min_epi32(_mm_loadu_si128((const __m128i *) (high + i)),
+                                            _mm_loadu_si128((const __m128i *) (high + i + 1))),
+                              _mm_loadu_si128((const __m128i *) (high + i + 2)));
+        _mm_storeu_si128((__m128i *) (out + i), median3Sse41(lows, middles, highs));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+median3Avx2(__m256i a, __m256i b, __m256i c) {
+    return _mm256_max_epi32(_mm256_min_epi32(a, b), _mm256_min_epi32(_mm256_max_epi32(a, b), c));
+}
+
+__attribute__((target("avx2")))
+static int
+sortAvx2(const int *above, const int *row, const int *below, int count, int *low, int *middle, int *high) {
+    __m256i a;
+    __m256i b;
+    __m256i c;
+    __m256i t;
+    int i;
+
+    for ( i = 0; i + 8 <= count; i += 8 ) {
+        a = _mm256_loadu_si256((const __m256i *) (above + i));
+        b = _mm256_loadu_si256((const __m256i *) (row + i));
+        c = _mm256_loadu_si256((const __m256i *) (below + i));
+        t = _mm256_min_epi32(a, b);
+        b = _mm256_max_epi32(a, b);
+        _mm256_storeu_si256((__m256i *) (low + i), _mm256_min_epi32(t, c));
+        _mm256_storeu_si256((__m256i *) (middle + i), median3Avx2(t, b, c));
+        _mm256_storeu_si256((__m256i *) (high + i), _mm256_max_epi32(b, c));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int
+medianAvx2(const int *low, const int *middle, const int *high, int count, int *out) {
+    __m256i lows;
+    __m256i middles;
+    __m256i highs;
+    int i;
+
+    for ( i = 0; i + 8 <= count; i += 8 ) {
+        lows = _mm256_max_epi32(_mm256_max_epi32(_mm256_loadu_si256((const __m256i *) (low + i)),
+                                                 _mm256_loadu_si256((const __m256i *) (low + i + 1))),
+                                _mm256_loadu_si256((const __m256i *) (low + i + 2)));
+        middles = median3Avx2(_mm256_loadu_si256((const __m256i *) (middle + i)),
+                              _mm256_loadu_si256((const __m256i *) (middle + i + 1)),
+                              _mm256_loadu_si256((const __m256i *) (middle + i + 2)));
+        highs = _mm256_min_epi32(_mm256_min_epi32(_mm256_loadu_si256((const __m256i *) (high + i)),
+                                                  _mm256_loadu_si256((const __m256i *) (high + i + 1))),
+                                 _mm256_loadu_si256((const __m256i *) (high + i + 2)));
+        _mm256_storeu_si256((__m256i *) (out + i), median3Avx2(lows, middles, highs));
+    }
+    return i;
+}
+
+#endif
+
+static struct MedianKernels
+selectKernels() {
+    struct MedianKernels kernels = {nullptr, nullptr};
+
+#ifdef MEDIAN_FILTER_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        kernels.sort = sortAvx2;
+        kernels.median = medianAvx2;
+    } else {
+        if ( cpuFeatures() & CPU_SSE41 ) {
+            kernels.sort = sortSse41;
+            kernels.median = medianSse41;
+        }
+    }
+#endif
+    return kernels;
+}
+
+static const struct MedianKernels &
+kernels() {
+    static const struct MedianKernels selected = selectKernels();
+
+    return selected;
+}
+
+void
+medianRow(const int *above, const int *row, const int *below, int count, int *sorted, int *out) {
+    int *low = sorted;
+    int *middle = sorted + count + 2;
+    int *high = sorted + 2 * (count + 2);
+    int done = 0;
+
+    if ( kernels().sort ) {
+        done = kernels().sort(above, row, below, count + 2, low, middle, high);
+    }
+    sortScalar(above, row, below, done, count + 2, low, middle, high);
+    done = 0;
+    if ( kernels().median ) {
+        done = kernels().median(low, middle, high, count, out);
+    }
+    medianScalar(low, middle, high, done, count, out);
+}
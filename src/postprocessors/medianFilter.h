@@ -0,0 +1,15 @@
+#ifndef __MEDIAN_FILTER__
+#define __MEDIAN_FILTER__
+
+/**
+ * Medians of the 3x3 neighbourhoods along a row of color differences: out[i] is the median of columns i to
+ * i + 2 of above, row and below, for i < count. sorted is scratch for 3 * (count + 2) ints.
+ *
+ * Each column of three is sorted once, then the median of a neighbourhood is the median of the largest of
+ * its three minimums, the median of its three middles and the smallest of its three maximums, as in the
+ * 19 exchange network. Columns are done eight at a time with AVX2 or four at a time with SSE4.1 when the
+ * processor has them.
+ */
+extern void medianRow(const int *above, const int *row, const int *below, int count, int *sorted, int *out);
+
+#endif
@@ -0,0 +1,174 @@
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WAVELET_DENOISE_X86
+#include <immintrin.h>
+#endif
+
+#include "../common/cpuFeatures.h"
+#include "waveletDenoise.h"
+
+// Filters a prefix of the samples, returns the number of samples done
+typedef int (*HatKernel)(const float *center, const float *before, const float *after, int count, float *out);
+
+// Thresholds a prefix of the samples, returns the number of samples done
+typedef int (*ThresholdKernel)(float *high, const float *low, float *sum, int count, float threshold);
+
+struct WaveletKernels {
+    HatKernel hat;
+    ThresholdKernel threshold;
+};
+
+static void
+hatScalar(const float *center, const float *before, const float *after, int first, int count, float *out) {
+    int i;
+
+    for ( i = first; i < count; i++ ) {
+        out[i] = (2 * center[i] + before[i] + after[i]) * 0.25f;
+    }
+}
+
+static void
+thresholdScalar(float *high, const float *low, float *sum, int first, int count, float threshold) {
+    int i;
+
+    for ( i = first; i < count; i++ ) {
+        high[i] -= low[i];
+        if ( high[i] < -threshold ) {
+            high[i] += threshold;
+        } else {
+            if ( high[i] > threshold ) {
+                high[i] -= threshold;
+            } else {
+                high[i] = 0;
+            }
+        }
+        if ( sum ) {
+            sum[i] += high[i];
+        }
+    }
+}
+
+#ifdef WAVELET_DENOISE_X86
+
+__attribute__((target("sse4.1")))
+static int
+hatSse41(const float *center, const float *before, const float *after, int count, float *out) {
+    const __m128 two = _mm_set1_ps(2);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    __m128 sum;
+    int i;
+
+    for ( i = 0; i + 4 <= count; i += 4 ) {
+        sum = _mm_add_ps(_mm_mul_ps(two, _mm_loadu_ps(center + i)), _mm_loadu_ps(before + i));
+        sum = _mm_add_ps(sum, _mm_loadu_ps(after + i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(sum, quarter));
+    }
+    return i;
+}
+
+/*
+Both shifted values are computed and the comparisons pick one of them or zero
+*/
+__attribute__((target("sse4.1")))
+static int
+thresholdSse41(float *high, const float *low, float *sum, int count, float threshold) {
+    const __m128 positive = _mm_set1_ps(threshold);
+    const __m128 negative = _mm_set1_ps(-threshold);
+    __m128 value;
+    __m128 result;
+    int i;
+
+    for ( i = 0; i + 4 <= count; i += 4 ) {
+        value = _mm_sub_ps(_mm_loadu_ps(high + i), _mm_loadu_ps(low + i));
+        result = _mm_and_ps(_mm_cmpgt_ps(value, positive), _mm_sub_ps(value, positive));
+        result = _mm_blendv_ps(result, _mm_add_ps(value, positive), _mm_cmplt_ps(value, negative));
+        _mm_storeu_ps(high + i, result);
+        if ( sum ) {
+            _mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), result));
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int
+hatAvx2(const float *center, const float *before, const float *after, int count, float *out) {
+    const __m256 two = _mm256_set1_ps(2);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    __m256 sum;
+    int i;
+
+    for ( i = 0; i + 8 <= count; i += 8 ) {
+        sum = _mm256_add_ps(_mm256_mul_ps(two, _mm256_loadu_ps(center + i)), _mm256_loadu_ps(before + i));
+        sum = _mm256_add_ps(sum, _mm256_loadu_ps(after + i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(sum, quarter));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static int
+thresholdAvx2(float *high, const float *low, float *sum, int count, float threshold) {
+    const __m256 positive = _mm256_set1_ps(threshold);
+    const __m256 negative = _mm256_set1_ps(-threshold);
+    __m256 value;
+    __m256 result;
+    int i;
+
+    for ( i = 0; i + 8 <= count; i += 8 ) {
+        value = _mm256_sub_ps(_mm256_loadu_ps(high + i), _mm256_loadu_ps(low + i));
+        result = _mm256_and_ps(_mm256_cmp_ps(value, positive, _CMP_GT_OQ), _mm256_sub_ps(value, positive));
+        result = _mm256_blendv_ps(result, _mm256_add_ps(value, positive), _mm256_cmp_ps(value, negative, _CMP_LT_OQ));
+        _mm256_storeu_ps(high + i, result);
+        if ( sum ) {
+            _mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), result));
+        }
+    }
+    return i;
+}
+
+#endif
+
+static struct WaveletKernels
+selectKernels() {
+    struct WaveletKernels kernels = {nullptr, nullptr};
+
+#ifdef WAVELET_DENOISE_X86
+    if ( cpuFeatures() & CPU_AVX2 ) {
+        kernels.hat = hatAvx2;
+        kernels.threshold = thresholdAvx2;
+    } else {
+        if ( cpuFeatures() & CPU_SSE41 ) {
+            kernels.hat = hatSse41;
+            kernels.threshold = thresholdSse41;
+        }
+    }
+#endif
+    return kernels;
+}
+
+static const struct WaveletKernels &
+kernels() {
+    static const struct WaveletKernels selected = selectKernels();
+
+    return selected;
+}
+
+void
+waveletHatRow(const float *center, const float *before, const float *after, int count, float *out) {
+    int done = 0;
+
+    if ( kernels().hat ) {
+        done = kernels().hat(center, before, after, count, out);
+    }
+    hatScalar(center, before, after, done, count, out);
+}
+
+void
+waveletThresholdRow(float *high, const float *low, float *sum, int count, float threshold) {
+    int done = 0;
+
+    if ( kernels().threshold ) {
+        done = kernels().threshold(high, low, sum, count, threshold);
+    }
+    thresholdScalar(high, low, sum, done, count, threshold);
+}
@@ -0,0 +1,30 @@
+#ifndef __WAVELET_DENOISE__
+#define __WAVELET_DENOISE__
+
+// Columns filtered together by the vertical pass of wavelet_denoise()
+#define WAVELET_COLUMN_BLOCK 16
+
+// Samples on each side of a tile read by the five levels of wavelet_denoise(): 1 + 2 + 4 + 8 + 16
+#define WAVELET_HALO 31
+
+// Smallest tile side wavelet_denoise() goes down to, keeping the halos a fraction of the tile
+#define WAVELET_MIN_TILE 64
+
+// MB the tiles of wavelet_denoise() fit in when the image is too large to be done at once
+#define WAVELET_MEMORY 1024
+
+/**
+ * One step of the a trous filter of wavelet_denoise(): out[i] = (2 * center[i] + before[i] + after[i]) * 0.25,
+ * summed in that order whatever the instruction set, so results do not depend on it.
+ * before and after are the samples at the current spacing on each side: the neighbouring columns of a row, or
+ * the rows above and below for a block of columns.
+ */
+extern void waveletHatRow(const float *center, const float *before, const float *after, int count, float *out);
+
+/**
+ * Turns count samples of high into the detail between them and low and applies the soft threshold to it, then
+ * adds the result to sum when it is not null.
+ */
+extern void waveletThresholdRow(float *high, const float *low, float *sum, int count, float threshold);
+
+#endif